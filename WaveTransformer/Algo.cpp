@@ -2,49 +2,156 @@
 
 namespace algo
 {
-	bool convertMp3 = false;
-	bool mpg124_verbose = false;
+	thread_local bool convertMp3 = false;
+	thread_local bool mpg124_verbose = false;
+	thread_local bool parallelMp3 = false;
+	thread_local io::Range inputRange{};
+	thread_local bool wavInput = false;
+	thread_local std::ostream* report = &std::cout;
 
 	namespace util
 	{
-		std::vector<std::uint8_t> GetAudioData(const std::string& inputFile, const std::string& algoName, const WavMetadata* wavm, bool ignoreMp3)
+		static io::MappedFile MapInput(const std::string& inputFile, const std::string& algoName)
 		{
-			std::ifstream inputStream{ inputFile, std::ios::binary };
-			if (!inputStream)
+			try
+			{
+				return io::MappedFile{ inputFile };
+			}
+			catch (const std::runtime_error&)
 			{
 				std::cerr << "(algo::" << algoName << ") Error: Unable to open input file: " << inputFile << std::endl;
 				throw std::runtime_error("(algo::" + algoName + ") Failed to open input file");
 			}
-			// read input file data to audioData
-			std::vector<std::uint8_t> output{ (std::istreambuf_iterator<char>(inputStream)), std::istreambuf_iterator<char>() };
+		}
+
+		// only the bytes of inputRange, read with positioned reads instead of mapping the whole file
+		static std::vector<std::uint8_t> ReadInputRange(const std::string& inputFile, const std::string& algoName)
+		{
+			try
+			{
+				stats::Scope scope{ "read" };
+				std::vector<std::uint8_t> data = io::ReadRange(inputFile, inputRange);
+				scope.BytesIn(data.size());
+				return data;
+			}
+			catch (const std::runtime_error& e)
+			{
+				std::cerr << "(algo::" << algoName << ") Error: Unable to read input file: " << inputFile << " (" << e.what() << ")" << std::endl;
+				throw std::runtime_error("(algo::" + algoName + ") Failed to read input file");
+			}
+		}
+
+		// the data chunk of a mapped wave input, cut to inputRange
+		static io::Range SampleRange(const io::MappedFile& file, const std::string& inputFile, const std::string& algoName)
+		{
+			try
+			{
+				wf::WaveFile::Contents contents = wf::WaveFile::Parse(file.Span());
+				return { contents.dataOffset + inputRange.offset, inputRange.Clamp(contents.dataSize) };
+			}
+			catch (const std::runtime_error& e)
+			{
+				std::cerr << "(algo::" << algoName << ") Error: Unable to read wave input: " << inputFile << " (" << e.what() << ")" << std::endl;
+				throw std::runtime_error("(algo::" + algoName + ") Invalid wave input");
+			}
+		}
+
+		io::Range InputRange(const std::string& inputFile, const std::string& algoName)
+		{
+			if (!wavInput) return inputRange;
+
+			// mapping only faults in the pages of the header that are walked
+			return SampleRange(MapInput(inputFile, algoName), inputFile, algoName);
+		}
+
+		AudioSource GetAudioSource(const std::string& inputFile, const std::string& algoName, const WavMetadata* wavm, bool ignoreMp3)
+		{
+			if (wavInput)
+			{
+				stats::Scope scope{ "map" };
+				io::MappedFile mapped = MapInput(inputFile, algoName);
+				io::Range range = SampleRange(mapped, inputFile, algoName);
+				scope.BytesIn(range.length);
+				AudioSource samples{ std::move(mapped), static_cast<std::size_t>(range.offset), static_cast<std::size_t>(range.length) };
+				if (convertMp3 && !ignoreMp3)
+					return AudioSource{ WavToMp3(samples.Span(), wavm->sampleRate, wavm->bps, wavm->channels, wavm->format) };
+
+				return samples;
+			}
+
+			if (!inputRange.Whole())
+			{
+				std::vector<std::uint8_t> data = ReadInputRange(inputFile, algoName);
+				if (convertMp3 && !ignoreMp3)
+					return AudioSource{ WavToMp3(data, wavm->sampleRate, wavm->bps, wavm->channels, wavm->format) };
+
+				return AudioSource{ std::move(data) };
+			}
+
+			io::MappedFile mapped = [&]()
+			{
+				stats::Scope scope{ "map" };
+				io::MappedFile file = MapInput(inputFile, algoName);
+				scope.BytesIn(file.Size());
+				return file;
+			}();
 
 			if (convertMp3 && !ignoreMp3)
-				output = WavToMp3(output, wavm->sampleRate, wavm->bps, wavm->channels, wavm->format);
+				return AudioSource{ WavToMp3(mapped.Span(), wavm->sampleRate, wavm->bps, wavm->channels, wavm->format) };
 
-			return output;
+			return AudioSource{ std::move(mapped) };
 		}
 
-		std::vector<std::vector<std::uint8_t>> GetAudioData(const std::vector<std::string>& inputFiles, const std::string& algoName, const WavMetadata* wavm, bool ignoreMp3)
+		std::vector<AudioSource> GetAudioSource(const std::vector<std::string>& inputFiles, const std::string& algoName, const WavMetadata* wavm, bool ignoreMp3)
 		{
-			std::vector<std::vector<std::uint8_t>> allData;
+			std::vector<AudioSource> allData;
+			allData.reserve(inputFiles.size());
 			for (const auto& file : inputFiles)
 			{
-				std::ifstream inputStream{ file, std::ios::binary };
-				if (!inputStream)
-				{
-					std::cerr << "(algo::" << algoName << ") Error: Unable to open input file: " << file << std::endl;
-					throw std::runtime_error("(algo::" + algoName + ") Failed to open input file");
-				}
+				allData.push_back(GetAudioSource(file, algoName, wavm, ignoreMp3));
+			}
+			return allData;
+		}
+
+		std::vector<std::uint8_t> GetAudioData(const std::string& inputFile, const std::string& algoName, const WavMetadata* wavm, bool ignoreMp3)
+		{
+			if (wavInput)
+			{
+				AudioSource samples = GetAudioSource(inputFile, algoName, wavm, true);
+				if (convertMp3 && !ignoreMp3)
+					return WavToMp3(samples.Span(), wavm->sampleRate, wavm->bps, wavm->channels, wavm->format);
 
-				std::vector<std::uint8_t> output{ (std::istreambuf_iterator<char>(inputStream)), std::istreambuf_iterator<char>() };
+				return { samples.Span().begin(), samples.Span().end() };
+			}
 
+			if (!inputRange.Whole())
+			{
+				std::vector<std::uint8_t> data = ReadInputRange(inputFile, algoName);
 				if (convertMp3 && !ignoreMp3)
-					output = WavToMp3(output, wavm->sampleRate, wavm->bps, wavm->channels, wavm->format);
+					return WavToMp3(data, wavm->sampleRate, wavm->bps, wavm->channels, wavm->format);
 
-				// read input file data to audioData
-				allData.push_back(std::move(output));
+				return data;
+			}
+
+			// the mp3 encoder reads straight from the mapping, so the raw bytes are never copied
+			if (convertMp3 && !ignoreMp3)
+			{
+				io::MappedFile mapped = MapInput(inputFile, algoName);
+				return WavToMp3(mapped.Span(), wavm->sampleRate, wavm->bps, wavm->channels, wavm->format);
+			}
+
+			try
+			{
+				stats::Scope scope{ "read" };
+				std::vector<std::uint8_t> data = io::ReadAll(inputFile);
+				scope.BytesIn(data.size());
+				return data;
+			}
+			catch (const std::runtime_error&)
+			{
+				std::cerr << "(algo::" << algoName << ") Error: Unable to open input file: " << inputFile << std::endl;
+				throw std::runtime_error("(algo::" + algoName + ") Failed to open input file");
 			}
-			return allData;
 		}
 
 		void ReturnAudioData(std::vector<uint8_t>& audioData, const WavMetadata* wavm)
@@ -55,4 +162,4 @@ namespace algo
 			}
 		}
 	}
-}
\ No newline at end of file
+}
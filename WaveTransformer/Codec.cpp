@@ -0,0 +1,186 @@
+#include "include/Codec.h"
+#include "include/Parallel.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace codec
+{
+	namespace
+	{
+		struct PooledDecoder
+		{
+			mpg123_handle* mh;
+			long rate;
+			int channels;
+			int encoding;
+			bool verbose;
+		};
+
+		struct DecoderPool
+		{
+			std::mutex mutex;
+			std::vector<PooledDecoder> idle;
+		};
+
+		DecoderPool& Pool()
+		{
+			static DecoderPool pool;
+			return pool;
+		}
+
+		void Shutdown()
+		{
+			DecoderPool& pool = Pool();
+			std::lock_guard<std::mutex> lock{ pool.mutex };
+			for (const PooledDecoder& decoder : pool.idle)
+			{
+				mpg123_delete(decoder.mh);
+			}
+			pool.idle.clear();
+			mpg123_exit();
+		}
+	}
+
+	void Init()
+	{
+		static std::once_flag once;
+		std::call_once(once, []()
+		{
+			// the pool must exist before Shutdown is registered so it is destroyed after it runs
+			Pool();
+			mpg123_init();
+			std::atexit(Shutdown);
+		});
+	}
+
+	Encoder::Encoder(wf::WaveFile::SampleRate sampleRate, wf::WaveFile::Channels channels, bool independentFrames)
+	{
+		lame = lame_init();
+		if (!lame)
+		{
+			std::cerr << "(algo::util::WavToMp3) Error: Unable to initialize LAME encoder" << std::endl;
+			throw std::runtime_error("(algo::util::WavToMp3) LAME initialization failed");
+		}
+
+		lame_set_in_samplerate(lame, static_cast<int>(sampleRate));
+		lame_set_num_channels(lame, static_cast<int>(channels));
+		lame_set_VBR(lame, vbr_default);
+		//lame_set_quality(lame, 5);
+		if (independentFrames)
+		{
+			lame_set_disable_reservoir(lame, 1);
+			lame_set_bWriteVbrTag(lame, 0);
+		}
+		if (lame_init_params(lame) < 0)
+		{
+			std::cerr << "(algo::util::WavToMp3) Error: Unable to set LAME parameters" << std::endl;
+			lame_close(lame);
+			throw std::runtime_error("(algo::util::WavToMp3) LAME parameter initialization failed");
+		}
+	}
+
+	Encoder::~Encoder()
+	{
+		if (lame) lame_close(lame);
+	}
+
+	Encoder::Encoder(Encoder&& other) noexcept
+		: lame(std::exchange(other.lame, nullptr))
+	{}
+
+	Encoder& Encoder::operator=(Encoder&& other) noexcept
+	{
+		if (this != &other)
+		{
+			if (lame) lame_close(lame);
+			lame = std::exchange(other.lame, nullptr);
+		}
+		return *this;
+	}
+
+	Decoder::Decoder(wf::WaveFile::SampleRate sampleRate, wf::WaveFile::Channels channels, int encoding, bool verbose)
+		: rate(static_cast<long>(sampleRate)), channels(static_cast<int>(channels)), encoding(encoding), verbose(verbose)
+	{
+		Init();
+
+		{
+			DecoderPool& pool = Pool();
+			std::lock_guard<std::mutex> lock{ pool.mutex };
+			for (std::size_t i = pool.idle.size(); i-- > 0;)
+			{
+				const PooledDecoder& pooled = pool.idle[i];
+				if (pooled.rate == rate && pooled.channels == this->channels && pooled.encoding == encoding && pooled.verbose == verbose)
+				{
+					mh = pooled.mh;
+					pool.idle.erase(pool.idle.begin() + i);
+					break;
+				}
+			}
+		}
+
+		if (!mh)
+		{
+			mh = mpg123_new(nullptr, nullptr);
+			if (!mh)
+			{
+				std::cerr << "(algo::util::Mp3ToWav) Error: Unable to initialize mpg123 decoder" << std::endl;
+				throw std::runtime_error("(algo::util::Mp3ToWav) mpg123 initialization failed");
+			}
+
+			mpg123_format_none(mh);
+			mpg123_format(mh, rate, this->channels, encoding);
+			if (!verbose) mpg123_param(mh, MPG123_ADD_FLAGS, MPG123_QUIET, 0);
+		}
+
+		if (mpg123_open_feed(mh) != MPG123_OK)
+		{
+			std::cerr << "(algo::util::Mp3ToWav) Error: Unable to open mpg123 feed" << std::endl;
+			mpg123_delete(mh);
+			throw std::runtime_error("(algo::util::Mp3ToWav) mpg123 open feed failed");
+		}
+	}
+
+	Decoder::~Decoder()
+	{
+		Release();
+	}
+
+	Decoder::Decoder(Decoder&& other) noexcept
+		: mh(std::exchange(other.mh, nullptr)), rate(other.rate), channels(other.channels), encoding(other.encoding), verbose(other.verbose)
+	{}
+
+	Decoder& Decoder::operator=(Decoder&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Release();
+			mh = std::exchange(other.mh, nullptr);
+			rate = other.rate;
+			channels = other.channels;
+			encoding = other.encoding;
+			verbose = other.verbose;
+		}
+		return *this;
+	}
+
+	void Decoder::Release()
+	{
+		if (!mh) return;
+
+		mpg123_close(mh);
+
+		// keep about one idle handle per thread, anything beyond that is freed
+		DecoderPool& pool = Pool();
+		std::lock_guard<std::mutex> lock{ pool.mutex };
+		if (pool.idle.size() < 2 * par::ThreadCount())
+			pool.idle.push_back({ mh, rate, channels, encoding, verbose });
+		else
+			mpg123_delete(mh);
+		mh = nullptr;
+	}
+}
@@ -0,0 +1,709 @@
+#include "include/Job.h"
+#include "include/InputParser.h"
+#include "include/Algo.h"
+#include "include/MappedFile.h"
+#include "include/Parallel.h"
+#include "include/Stats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace job
+{
+	namespace
+	{
+		bool HasOption(const InputParser& parser, const char* shortName, const char* longName)
+		{
+			return parser.cmdOptionExists(shortName) || parser.cmdOptionExists(longName);
+		}
+
+		const std::string& GetOption(const InputParser& parser, const char* shortName, const char* longName)
+		{
+			return parser.getCmdOption(parser.cmdOptionExists(shortName) ? shortName : longName);
+		}
+
+		[[noreturn]] void Invalid(const std::string& message)
+		{
+			std::cerr << "Error: " << message << std::endl;
+			throw std::runtime_error(message);
+		}
+
+		// MiB of input a job reads (only its range of each input), rounded up; inputs that cannot be sized count as nothing
+		// and fail later when the job opens them
+		std::size_t InputMegabytes(const Job& job)
+		{
+			std::uintmax_t bytes = 0;
+			for (const std::string& input : job.inputs)
+			{
+				std::error_code ec;
+				std::uintmax_t size = std::filesystem::file_size(input, ec);
+				if (!ec && job.range.offset <= size) bytes += job.range.Clamp(size);
+			}
+			return static_cast<std::size_t>(std::max<std::uintmax_t>(1, (bytes + (1 << 20) - 1) >> 20));
+		}
+
+		std::vector<std::string> Split(const std::string& text, char separator)
+		{
+			std::vector<std::string> parts;
+			std::size_t begin = 0;
+			for (std::size_t end; (end = text.find(separator, begin)) != std::string::npos; begin = end + 1)
+			{
+				parts.push_back(text.substr(begin, end - begin));
+			}
+			parts.push_back(text.substr(begin));
+			return parts;
+		}
+
+		// "op:s=512:a" to the tokens "op -s 512 -a"
+		std::vector<std::string> StageTokens(const std::string& stage)
+		{
+			std::vector<std::string> parts = Split(stage, opt::operation::PIPE_PARAM_SEPARATOR);
+			std::vector<std::string> tokens{ parts.front() };
+			for (std::size_t i = 1; i < parts.size(); ++i)
+			{
+				std::size_t equals = parts[i].find('=');
+				std::string key = parts[i].substr(0, equals);
+				if (key.empty())
+					Invalid("Invalid pipeline stage parameter: " + parts[i]);
+
+				std::string option = (key.size() == 1 ? "-" : "--") + key;
+				tokens.push_back(option);
+				if (equals == std::string::npos) continue;
+
+				std::string value = parts[i].substr(equals + 1);
+				if (option == opt::BLOCK_RANGE_SHORT || option == opt::BLOCK_RANGE_LONG)
+				{
+					// min-max, passed on as the two values the option takes
+					std::vector<std::string> range = Split(value, '-');
+					tokens.insert(tokens.end(), range.begin(), range.end());
+				}
+				else
+				{
+					tokens.push_back(value);
+				}
+			}
+			return tokens;
+		}
+
+		// the in-memory form of a parsed pipe stage
+		algo::Stage MakeStage(const Job& stage, const algo::WavMetadata& wavm)
+		{
+			using namespace opt::operation;
+
+			switch (stage.operation)
+			{
+			case OP_SHUFFLE:
+				return { stage.name, {}, [stage, wavm](std::span<const std::uint8_t> input, std::vector<std::uint8_t>& output)
+				{
+					algo::ByteBlockShuffle(input, output, &wavm, stage.blockSize, stage.align);
+				} };
+			case OP_RANGE_SHUFFLE:
+				return { stage.name, {}, [stage, wavm](std::span<const std::uint8_t> input, std::vector<std::uint8_t>& output)
+				{
+					algo::ShuffleRange(input, output, &wavm, stage.min, stage.max, stage.align);
+				} };
+			case OP_DROPOUT:
+				return { stage.name, {}, [stage, wavm](std::span<const std::uint8_t> input, std::vector<std::uint8_t>& output)
+				{
+					algo::Dropout(input, output, &wavm, stage.probability, stage.seed);
+				} };
+			case OP_BYTE_MIRROR:
+				if (stage.sampleDomain)
+					return { stage.name, algo::sample::Mirror(stage.blockSize, wavm.bps, wavm.channels), {} };
+				return { stage.name, algo::kernel::ByteMirror(stage.blockSize, algo::util::Alignment(&wavm, stage.align)), {} };
+			case OP_BIT_FLIP:
+				if (stage.sampleDomain)
+					return { stage.name, algo::sample::BitFlip(stage.probability, stage.seed, wavm.bps, wavm.channels), {} };
+				return { stage.name, algo::kernel::ByteBitFlip(stage.probability, stage.seed), {} };
+			case OP_CASCADE_SWAP:
+				if (stage.sampleDomain)
+					return { stage.name, algo::sample::CascadeSwap(stage.blockSize, wavm.bps, wavm.channels), {} };
+				return { stage.name, algo::kernel::ByteCascadeSwap(stage.blockSize, algo::util::Alignment(&wavm, stage.align)), {} };
+			case OP_STUTTER:
+				if (stage.sampleDomain)
+					return { stage.name, algo::sample::Stutter(stage.nthbyte, wavm.bps, wavm.channels), {} };
+				return { stage.name, algo::kernel::Stutter(stage.nthbyte), {} };
+			default:
+				throw std::runtime_error("Operation cannot be a pipeline stage: " + stage.name);
+			}
+		}
+
+		// the sample-domain variants only exist as kernels: streamed when the job can stream,
+		// otherwise run like a pipe of one stage
+		void RunSampleKernel(const Job& job, const algo::WavMetadata& wavm, bool chunked, wf::WaveFile& waveFile, std::vector<std::uint8_t>& audioData)
+		{
+			algo::Stage stage = MakeStage(job, wavm);
+			if (chunked)
+				algo::RunChunked(job.inputs.front(), waveFile, stage.kernel, stage.name, &wavm);
+			else
+				algo::RunPipeline(job.inputs.front(), { stage }, audioData, &wavm);
+		}
+
+		// holds part of a budget for as long as a job runs, released even when it throws
+		class BudgetLease
+		{
+		public:
+			BudgetLease(par::Budget& budget, std::size_t amount) : budget(budget), amount(budget.Acquire(amount)) {}
+			~BudgetLease() { budget.Release(amount); }
+
+			BudgetLease(const BudgetLease&) = delete;
+			BudgetLease& operator=(const BudgetLease&) = delete;
+
+		private:
+			par::Budget& budget;
+			std::size_t amount;
+		};
+	}
+
+	Job Parse(const std::vector<std::string>& tokens)
+	{
+		using namespace opt::operation;
+
+		Job job;
+		InputParser parser{ tokens };
+
+		// take the first param to be the operation
+		if (tokens.empty())
+			Invalid("No operation specified.");
+		job.name = tokens[0];
+
+		if (job.name == REINTERPRET)
+			job.operation = OP_REINTERPRET;
+		else if (job.name == INTERLACE)
+			job.operation = OP_INTERLACE;
+		else if (job.name == SHUFFLE)
+			job.operation = OP_SHUFFLE;
+		else if (job.name == BYTE_MIRROR)
+			job.operation = OP_BYTE_MIRROR;
+		else if (job.name == BIT_FLIP)
+			job.operation = OP_BIT_FLIP;
+		else if (job.name == CASCADE_SWAP)
+			job.operation = OP_CASCADE_SWAP;
+		else if (job.name == RANGE_SHUFFLE)
+			job.operation = OP_RANGE_SHUFFLE;
+		else if (job.name == DROPOUT)
+			job.operation = OP_DROPOUT;
+		else if (job.name == STUTTER)
+			job.operation = OP_STUTTER;
+		else if (job.name == ENCODE_MP3)
+			job.operation = OP_ENCODE_MP3;
+		else if (job.name == DECODE_MP3)
+			job.operation = OP_DECODE_MP3;
+		else if (job.name == PIPE)
+			job.operation = OP_PIPE;
+		else
+			Invalid("Invalid operation specified: " + job.name);
+
+		// take the arguments after the operation as inputs and stop when an option is found
+		for (std::size_t i = 1; i < tokens.size() && tokens[i].rfind("-", 0) != 0; ++i)
+		{
+			job.inputs.push_back(tokens[i]);
+		}
+
+		// wave inputs bring their format along, the format options below only override it;
+		// the first argument of pipe is its stage list, the wave file follows it
+		job.wavInput = HasOption(parser, opt::WAV_INPUT_SHORT, opt::WAV_INPUT_LONG);
+		std::size_t firstInput = job.operation == OP_PIPE ? 1 : 0;
+		if (job.wavInput && job.inputs.size() > firstInput)
+		{
+			const std::string& waveInput = job.inputs[firstInput];
+			try
+			{
+				wf::WaveFile::Contents contents = wf::WaveFile{ waveInput }.ReadIn();
+				job.sampleRate = contents.sampleRate;
+				job.bitDepth = contents.bps;
+				job.channels = contents.channels;
+				job.format = contents.format;
+			}
+			catch (const std::runtime_error& e)
+			{
+				Invalid("Unable to read wave input " + waveInput + " (" + e.what() + ")");
+			}
+		}
+
+		if (HasOption(parser, opt::SAMPLE_RATE_SHORT, opt::SAMPLE_RATE_LONG))
+			job.sampleRate = static_cast<wf::WaveFile::SampleRate>(std::stoi(GetOption(parser, opt::SAMPLE_RATE_SHORT, opt::SAMPLE_RATE_LONG)));
+
+		if (HasOption(parser, opt::BIT_DEPTH_SHORT, opt::BIT_DEPTH_LONG))
+			job.bitDepth = static_cast<wf::WaveFile::BitsPerSample>(std::stoi(GetOption(parser, opt::BIT_DEPTH_SHORT, opt::BIT_DEPTH_LONG)));
+
+		if (HasOption(parser, opt::CHANNELS_SHORT, opt::CHANNELS_LONG))
+		{
+			const std::string& channelsStr = GetOption(parser, opt::CHANNELS_SHORT, opt::CHANNELS_LONG);
+			int ch;
+
+			if (channelsStr == opt::channels::CHAN_MONO)
+				ch = opt::channels::MONO;
+			else if (channelsStr == opt::channels::CHAN_STEREO)
+				ch = opt::channels::STEREO;
+			else
+				Invalid("Invalid channels option: " + channelsStr);
+
+			job.channels = static_cast<wf::WaveFile::Channels>(ch);
+		}
+
+		if (HasOption(parser, opt::FORMAT_SHORT, opt::FORMAT_LONG))
+		{
+			const std::string& formatStr = GetOption(parser, opt::FORMAT_SHORT, opt::FORMAT_LONG);
+			int fmt;
+
+			if (formatStr == opt::format::FMT_PCM)
+				fmt = opt::format::PCM;
+			else if (formatStr == opt::format::FMT_IEEE_FLOAT)
+				fmt = opt::format::IEEE_FLOAT;
+			else
+				Invalid("Invalid format option: " + formatStr);
+
+			job.format = static_cast<wf::WaveFile::AudioFormat>(fmt);
+		}
+
+		if (HasOption(parser, opt::OUT_SHORT, opt::OUT_LONG))
+		{
+			job.outputFile = GetOption(parser, opt::OUT_SHORT, opt::OUT_LONG);
+			job.outputNoTag = job.outputFile;
+		}
+
+		job.tag = HasOption(parser, opt::TAG_SHORT, opt::TAG_LONG);
+		if (job.tag)
+			job.outputFile = opt::TagFile(job.outputNoTag, job.name, job.channels, job.sampleRate, job.bitDepth, job.format);
+
+		if (HasOption(parser, opt::BLOCK_SIZE_SHORT, opt::BLOCK_SIZE_LONG))
+			job.blockSize = static_cast<std::size_t>(std::stoul(GetOption(parser, opt::BLOCK_SIZE_SHORT, opt::BLOCK_SIZE_LONG)));
+
+		if (HasOption(parser, opt::PROBABILITY_SHORT, opt::PROBABILITY_LONG))
+			job.probability = std::stod(GetOption(parser, opt::PROBABILITY_SHORT, opt::PROBABILITY_LONG));
+
+		if (HasOption(parser, opt::BLOCK_RANGE_SHORT, opt::BLOCK_RANGE_LONG))
+		{
+			std::vector<std::string> rangeValues = parser.getMultipleOptions(parser.cmdOptionExists(opt::BLOCK_RANGE_SHORT) ? opt::BLOCK_RANGE_SHORT : opt::BLOCK_RANGE_LONG);
+			if (rangeValues.size() != 2)
+				Invalid("Block size range requires two values (min and max).");
+
+			job.min = static_cast<std::size_t>(std::stoul(rangeValues[0]));
+			job.max = static_cast<std::size_t>(std::stoul(rangeValues[1]));
+		}
+
+		job.align = HasOption(parser, opt::BLOCK_BYTE_ALIGN_SHORT, opt::BLOCK_BYTE_ALIGN_LONG);
+		job.sampleDomain = HasOption(parser, opt::SAMPLE_DOMAIN_SHORT, opt::SAMPLE_DOMAIN_LONG);
+
+		if (HasOption(parser, opt::NTH_BYTE_SHORT, opt::NTH_BYTE_LONG))
+			job.nthbyte = std::stoi(GetOption(parser, opt::NTH_BYTE_SHORT, opt::NTH_BYTE_LONG));
+
+		if (HasOption(parser, opt::UNIT_SHORT, opt::UNIT_LONG))
+		{
+			const std::string& unitStr = GetOption(parser, opt::UNIT_SHORT, opt::UNIT_LONG);
+			if (unitStr == opt::unit::UNIT_SAMPLE)
+				job.unit = static_cast<std::size_t>(job.bitDepth) / 8;
+			else
+				job.unit = static_cast<std::size_t>(std::stoul(unitStr));
+		}
+
+		if (HasOption(parser, opt::SEED_SHORT, opt::SEED_LONG))
+		{
+			job.seed = static_cast<std::uint64_t>(std::stoull(GetOption(parser, opt::SEED_SHORT, opt::SEED_LONG)));
+		}
+		else
+		{
+			std::random_device rd;
+			job.seed = (static_cast<std::uint64_t>(rd()) << 32) | rd();
+		}
+
+		if (HasOption(parser, opt::OFFSET_SHORT, opt::OFFSET_LONG))
+			job.range.offset = static_cast<std::uint64_t>(std::stoull(GetOption(parser, opt::OFFSET_SHORT, opt::OFFSET_LONG)));
+
+		if (HasOption(parser, opt::LENGTH_SHORT, opt::LENGTH_LONG))
+			job.range.length = static_cast<std::uint64_t>(std::stoull(GetOption(parser, opt::LENGTH_SHORT, opt::LENGTH_LONG)));
+
+		job.convertMp3 = HasOption(parser, opt::CONVERT_MP3_SHORT, opt::CONVERT_MP3_LONG);
+		job.verbose = HasOption(parser, opt::VERBOSE_MPG123_SHORT, opt::VERBOSE_MPG123_LONG);
+		job.parallelMp3 = HasOption(parser, opt::PARALLEL_MP3_SHORT, opt::PARALLEL_MP3_LONG);
+
+		job.stats = HasOption(parser, opt::STATS_SHORT, opt::STATS_LONG);
+		if (job.stats)
+		{
+			// the file name is optional, the next token may already be another option
+			const std::string& statsFile = GetOption(parser, opt::STATS_SHORT, opt::STATS_LONG);
+			if (statsFile.rfind("-", 0) != 0)
+				job.statsFile = statsFile;
+		}
+
+		if (job.operation == OP_PIPE)
+		{
+			// the first argument is the stage list, the input follows it
+			if (job.inputs.empty())
+				Invalid("No pipeline stages specified.");
+
+			std::vector<std::string> options{ tokens.begin() + 1 + job.inputs.size(), tokens.end() };
+			std::string spec = job.inputs.front();
+			job.inputs.erase(job.inputs.begin());
+
+			for (const std::string& stageSpec : Split(spec, PIPE_STAGE_SEPARATOR))
+			{
+				std::vector<std::string> stageTokens = StageTokens(stageSpec);
+				InputParser stageParser{ stageTokens };
+				bool ownSeed = HasOption(stageParser, opt::SEED_SHORT, opt::SEED_LONG);
+
+				stageTokens.insert(stageTokens.end(), options.begin(), options.end());
+				Job stage = Parse(stageTokens);
+
+				switch (stage.operation)
+				{
+				case OP_SHUFFLE:
+				case OP_BYTE_MIRROR:
+				case OP_BIT_FLIP:
+				case OP_CASCADE_SWAP:
+				case OP_RANGE_SHUFFLE:
+				case OP_DROPOUT:
+				case OP_STUTTER:
+					break;
+				default:
+					Invalid("Operation cannot be a pipeline stage: " + stage.name);
+				}
+
+				// stages sharing the seed of the whole command would draw the same numbers,
+				// two bit flips would even undo each other
+				if (!ownSeed)
+					stage.seed += job.stages.size();
+
+				job.stages.push_back(std::move(stage));
+			}
+		}
+
+		return job;
+	}
+
+	static int RunJob(const Job& job)
+	{
+		using namespace opt::operation;
+
+		algo::convertMp3 = job.convertMp3;
+		algo::mpg124_verbose = job.verbose;
+		algo::parallelMp3 = job.parallelMp3;
+		algo::inputRange = job.range;
+		algo::wavInput = job.wavInput;
+
+		algo::WavMetadata wavm{};
+		wavm.sampleRate = job.sampleRate;
+		wavm.bps = job.bitDepth;
+		wavm.channels = job.channels;
+		wavm.format = job.format;
+
+		*algo::report << "Operation: " << job.name << std::endl;
+		*algo::report << "Configured Wave File Parameters:" << std::endl;
+		*algo::report << "Sample Rate: " << static_cast<int>(job.sampleRate) << " Hz" << std::endl;
+		*algo::report << "Bit Depth: " << static_cast<int>(job.bitDepth) << " bits" << std::endl;
+		*algo::report << "Channels: " << static_cast<int>(job.channels) << std::endl;
+		*algo::report << "Format: " << (job.format == wf::WaveFile::AudioFormat::PCM ? "PCM" : "FLOAT") << std::endl;
+		if (!job.range.Whole())
+		{
+			*algo::report << "Offset: " << job.range.offset << std::endl;
+			if (job.range.length != io::Range::ToEnd)
+				*algo::report << "Length: " << job.range.length << std::endl;
+		}
+		if (job.operation == OP_BIT_FLIP || job.operation == OP_DROPOUT)
+			*algo::report << "Seed: " << job.seed << std::endl;
+		for (std::size_t i = 0; i < job.stages.size(); ++i)
+		{
+			if (job.stages[i].operation == OP_BIT_FLIP || job.stages[i].operation == OP_DROPOUT)
+				*algo::report << "Stage " << i + 1 << " Seed: " << job.stages[i].seed << std::endl;
+		}
+
+		// every operation but interlace reads the first input only
+		if (job.operation != OP_INTERLACE && job.inputs.empty())
+		{
+			std::cerr << "Error: No input file specified." << std::endl;
+			return 1;
+		}
+
+		std::string outputFile = job.outputFile;
+		wf::WaveFile waveFile{ outputFile, job.sampleRate, job.bitDepth, job.channels, job.format };
+
+		// block-local transforms stream window by window, through the encoder/decoder pipeline with mp3
+		// conversion; segment-parallel mp3 encoding needs the whole file, so it keeps the buffered path.
+		// reint never converts and copies the input straight into the output file
+		bool chunked = job.operation == OP_REINTERPRET || (!(job.convertMp3 && job.parallelMp3) &&
+			(job.operation == OP_BYTE_MIRROR || job.operation == OP_BIT_FLIP ||
+			job.operation == OP_CASCADE_SWAP || job.operation == OP_STUTTER));
+
+		std::vector<uint8_t> audioData;
+
+		try
+		{
+			stats::Scope scope{ job.name.c_str() };
+			switch (job.operation)
+			{
+			case OP_REINTERPRET:
+				algo::Reinterpret(job.inputs.front(), waveFile);
+				break;
+			case OP_INTERLACE:
+				algo::Interlace(job.inputs, audioData, &wavm, job.unit);
+				break;
+			case OP_SHUFFLE:
+				algo::ByteBlockShuffle(job.inputs.front(), audioData, &wavm, job.blockSize, job.align);
+				break;
+			case OP_BYTE_MIRROR:
+				if (job.sampleDomain)
+					RunSampleKernel(job, wavm, chunked, waveFile, audioData);
+				else if (chunked)
+					algo::RunChunked(job.inputs.front(), waveFile, algo::kernel::ByteMirror(job.blockSize, algo::util::Alignment(&wavm, job.align)), "ByteMirror", &wavm);
+				else
+					algo::ByteMirror(job.inputs.front(), audioData, &wavm, job.blockSize, job.align);
+				break;
+			case OP_BIT_FLIP:
+				if (job.sampleDomain)
+					RunSampleKernel(job, wavm, chunked, waveFile, audioData);
+				else if (chunked)
+					algo::RunChunked(job.inputs.front(), waveFile, algo::kernel::ByteBitFlip(job.probability, job.seed), "ByteBitFlip", &wavm);
+				else
+					algo::ByteBitFlip(job.inputs.front(), audioData, &wavm, job.probability, job.seed);
+				break;
+			case OP_CASCADE_SWAP:
+				if (job.sampleDomain)
+					RunSampleKernel(job, wavm, chunked, waveFile, audioData);
+				else if (chunked)
+					algo::RunChunked(job.inputs.front(), waveFile, algo::kernel::ByteCascadeSwap(job.blockSize, algo::util::Alignment(&wavm, job.align)), "ByteCascadeSwap", &wavm);
+				else
+					algo::ByteCascadeSwap(job.inputs.front(), audioData, &wavm, job.blockSize, job.align);
+				break;
+			case OP_RANGE_SHUFFLE:
+				algo::ShuffleRange(job.inputs.front(), audioData, &wavm, job.min, job.max, job.align);
+				break;
+			case OP_DROPOUT:
+				algo::Dropout(job.inputs.front(), audioData, &wavm, job.probability, job.seed);
+				break;
+			case OP_STUTTER:
+				if (job.sampleDomain)
+					RunSampleKernel(job, wavm, chunked, waveFile, audioData);
+				else if (chunked)
+					algo::RunChunked(job.inputs.front(), waveFile, algo::kernel::Stutter(job.nthbyte), "Stutter", &wavm);
+				else
+					algo::Stutter(job.inputs.front(), audioData, &wavm, job.nthbyte);
+				break;
+			case OP_ENCODE_MP3:
+			{
+				algo::util::AudioSource wavFile = algo::util::GetAudioSource(job.inputs.front(), "WavToMp3", &wavm, true);
+
+				auto out = algo::util::WavToMp3(wavFile.Span(), job.sampleRate, job.bitDepth, job.channels, job.format);
+
+				if (job.tag)
+					outputFile = opt::TagFile(job.outputNoTag, job.name, job.channels, job.sampleRate, job.bitDepth, wf::WaveFile::AudioFormat::MP3);
+
+				stats::Scope write{ "write" };
+				write.BytesOut(out.size());
+				std::ofstream mp3File{ outputFile, std::ios::binary };
+				mp3File.write(reinterpret_cast<const char*>(out.data()), out.size());
+
+				*algo::report << "MP3 file written to " << outputFile << std::endl;
+			}
+				return 0;
+			case OP_DECODE_MP3:
+			{
+				algo::util::AudioSource mp3File = algo::util::GetAudioSource(job.inputs.front(), "Mp3ToWav", &wavm, true);
+
+				audioData = algo::util::Mp3ToWav(mp3File.Span(), job.sampleRate, job.bitDepth, job.channels, job.format);
+			}
+				break;
+			case OP_PIPE:
+			{
+				std::vector<algo::Stage> stages;
+				stages.reserve(job.stages.size());
+				for (const Job& stage : job.stages)
+				{
+					stages.push_back(MakeStage(stage, wavm));
+				}
+
+				algo::RunPipeline(job.inputs.front(), stages, audioData, &wavm);
+			}
+				break;
+			default:
+				std::cerr << "Error: Unsupported operation." << std::endl;
+				return 1;
+			}
+		}
+		catch (std::runtime_error& e)
+		{
+			std::cerr << "Error during processing: " << e.what() << std::endl;
+			return 1;
+		}
+
+		if (chunked)
+		{
+			*algo::report << "Wave file written to " << outputFile << std::endl;
+			return 0;
+		}
+
+		*algo::report << "Audio data size: " << audioData.size() << " bytes" << std::endl;
+
+		{
+			stats::Scope scope{ "write" };
+			scope.BytesOut(audioData.size());
+			waveFile.SetData(std::move(audioData));
+			waveFile.WriteOut();
+		}
+
+		*algo::report << "Wave file written to " << outputFile << std::endl;
+
+		return 0;
+	}
+
+	int Run(const Job& job)
+	{
+		if (!job.stats)
+			return RunJob(job);
+
+		stats::Recorder recorder;
+		int result;
+		{
+			stats::Session session{ &recorder };
+			stats::Scope scope{ "total" };
+			result = RunJob(job);
+		}
+
+		if (job.statsFile.empty())
+		{
+			recorder.PrintTable(*algo::report);
+			return result;
+		}
+
+		std::ofstream statsFile{ job.statsFile };
+		if (!statsFile)
+		{
+			std::cerr << "Error: Unable to open stats file: " << job.statsFile << std::endl;
+			return 1;
+		}
+		recorder.WriteJson(statsFile);
+		*algo::report << "Stats written to " << job.statsFile << std::endl;
+		return result;
+	}
+
+	std::vector<std::string> Tokenize(const std::string& line)
+	{
+		std::vector<std::string> tokens;
+		std::string token;
+		bool quoted = false;
+		bool inToken = false;
+
+		for (char c : line)
+		{
+			if (c == '"')
+			{
+				quoted = !quoted;
+				inToken = true;
+			}
+			else if (!quoted && (c == ' ' || c == '\t' || c == '\r'))
+			{
+				if (inToken) tokens.push_back(std::move(token));
+				token.clear();
+				inToken = false;
+			}
+			else
+			{
+				token += c;
+				inToken = true;
+			}
+		}
+		if (inToken) tokens.push_back(std::move(token));
+
+		return tokens;
+	}
+
+	int RunBatch(const std::string& manifest, std::size_t workers, std::size_t ioBudget)
+	{
+		std::ifstream manifestFile{ manifest };
+		if (!manifestFile)
+		{
+			std::cerr << "Error: Unable to open manifest file: " << manifest << std::endl;
+			return 1;
+		}
+
+		struct Entry
+		{
+			std::size_t line;
+			std::vector<std::string> tokens;
+		};
+
+		std::vector<Entry> entries;
+		std::string line;
+		for (std::size_t number = 1; std::getline(manifestFile, line); ++number)
+		{
+			std::vector<std::string> tokens = Tokenize(line);
+			if (tokens.empty() || tokens.front().rfind("#", 0) == 0) continue;
+			entries.push_back({ number, std::move(tokens) });
+		}
+
+		std::size_t threads = std::min(workers > 0 ? workers : par::ThreadCount(), std::max<std::size_t>(1, entries.size()));
+		std::cout << "Batch: " << entries.size() << " jobs from " << manifest << " on " << threads << " workers, " << ioBudget << " MiB input budget" << std::endl;
+
+		par::Budget budget{ ioBudget };
+		std::atomic<std::size_t> next{ 0 };
+		std::atomic<std::size_t> failed{ 0 };
+		std::mutex reportMutex;
+
+		auto worker = [&]()
+		{
+			for (std::size_t i = next++; i < entries.size(); i = next++)
+			{
+				const Entry& entry = entries[i];
+				auto start = std::chrono::steady_clock::now();
+
+				std::string label = entry.tokens.front();
+				std::string error;
+				int result = 1;
+
+				// the job's progress lines are held back and printed with its status line
+				std::ostringstream jobReport;
+				algo::report = &jobReport;
+				try
+				{
+					Job job = Parse(entry.tokens);
+					label = job.name + " -> " + job.outputFile;
+
+					BudgetLease lease{ budget, InputMegabytes(job) };
+					result = Run(job);
+				}
+				catch (const std::exception& e)
+				{
+					// Run reports its own failures, this is for bad manifest lines
+					error = e.what();
+					result = 1;
+				}
+				algo::report = &std::cout;
+
+				double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				if (result != 0) ++failed;
+
+				std::lock_guard<std::mutex> lock{ reportMutex };
+				std::cout << jobReport.str();
+				std::cout << "[job " << entry.line << "] " << label << ": " << (result == 0 ? "OK" : "FAILED");
+				if (!error.empty()) std::cout << " (" << error << ")";
+				std::cout << " in " << seconds << " s" << std::endl;
+			}
+		};
+
+		std::vector<std::thread> pool;
+		pool.reserve(threads - 1);
+		for (std::size_t t = 1; t < threads; ++t)
+		{
+			pool.emplace_back(worker);
+		}
+		// the calling thread works through the manifest too
+		worker();
+
+		for (auto& thread : pool)
+		{
+			thread.join();
+		}
+
+		std::cout << "Batch: " << entries.size() - failed << " of " << entries.size() << " jobs succeeded" << std::endl;
+		return failed > 0 ? 1 : 0;
+	}
+}
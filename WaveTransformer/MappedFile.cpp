@@ -0,0 +1,424 @@
+#include "include/MappedFile.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+namespace io
+{
+	MappedFile::MappedFile(const std::string& path)
+	{
+		Open(path);
+	}
+
+	MappedFile::~MappedFile()
+	{
+		Close();
+	}
+
+	MappedFile::MappedFile(MappedFile&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Close();
+			data = std::exchange(other.data, nullptr);
+			size = std::exchange(other.size, 0);
+			open = std::exchange(other.open, false);
+#ifdef _WIN32
+			fileHandle = std::exchange(other.fileHandle, nullptr);
+			mappingHandle = std::exchange(other.mappingHandle, nullptr);
+#else
+			fd = std::exchange(other.fd, -1);
+#endif
+		}
+		return *this;
+	}
+
+	void MappedFile::Open(const std::string& path)
+	{
+		Close();
+
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			throw std::runtime_error("Failed to open file for reading: " + path);
+		}
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize))
+		{
+			CloseHandle(file);
+			throw std::runtime_error("Failed to query file size: " + path);
+		}
+
+		fileHandle = file;
+		size = static_cast<std::size_t>(fileSize.QuadPart);
+		open = true;
+
+		// empty files cannot be mapped
+		if (size == 0) return;
+
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping)
+		{
+			Close();
+			throw std::runtime_error("Failed to map file: " + path);
+		}
+		mappingHandle = mapping;
+
+		void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!view)
+		{
+			Close();
+			throw std::runtime_error("Failed to map file: " + path);
+		}
+		data = static_cast<const std::uint8_t*>(view);
+#else
+		fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+		{
+			throw std::runtime_error("Failed to open file for reading: " + path);
+		}
+
+		struct stat st;
+		if (::fstat(fd, &st) != 0)
+		{
+			::close(fd);
+			fd = -1;
+			throw std::runtime_error("Failed to query file size: " + path);
+		}
+
+		size = static_cast<std::size_t>(st.st_size);
+		open = true;
+
+		// empty files cannot be mapped
+		if (size == 0) return;
+
+		void* view = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (view == MAP_FAILED)
+		{
+			Close();
+			throw std::runtime_error("Failed to map file: " + path);
+		}
+		// the data is almost always walked front to back
+		::madvise(view, size, MADV_SEQUENTIAL);
+		data = static_cast<const std::uint8_t*>(view);
+#endif
+	}
+
+	void MappedFile::Close()
+	{
+#ifdef _WIN32
+		if (data) UnmapViewOfFile(data);
+		if (mappingHandle) CloseHandle(static_cast<HANDLE>(mappingHandle));
+		if (fileHandle) CloseHandle(static_cast<HANDLE>(fileHandle));
+		mappingHandle = nullptr;
+		fileHandle = nullptr;
+#else
+		if (data) ::munmap(const_cast<std::uint8_t*>(data), size);
+		if (fd >= 0) ::close(fd);
+		fd = -1;
+#endif
+		data = nullptr;
+		size = 0;
+		open = false;
+	}
+
+	bool MappedFile::IsOpen() const
+	{
+		return open;
+	}
+
+	const std::uint8_t* MappedFile::Data() const
+	{
+		return data;
+	}
+
+	std::size_t MappedFile::Size() const
+	{
+		return size;
+	}
+
+	std::span<const std::uint8_t> MappedFile::Span() const
+	{
+		return { data, size };
+	}
+
+	InputFile::InputFile(const std::string& path)
+	{
+		Open(path);
+	}
+
+	InputFile::~InputFile()
+	{
+		Close();
+	}
+
+	InputFile::InputFile(InputFile&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	InputFile& InputFile::operator=(InputFile&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Close();
+			path = std::move(other.path);
+			size = std::exchange(other.size, 0);
+#ifdef _WIN32
+			fileHandle = std::exchange(other.fileHandle, nullptr);
+#else
+			fd = std::exchange(other.fd, -1);
+#endif
+		}
+		return *this;
+	}
+
+	void InputFile::Open(const std::string& filePath)
+	{
+		Close();
+
+#ifdef _WIN32
+		HANDLE file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			throw std::runtime_error("Failed to open file for reading: " + filePath);
+		}
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize))
+		{
+			CloseHandle(file);
+			throw std::runtime_error("Failed to query file size: " + filePath);
+		}
+
+		fileHandle = file;
+		size = static_cast<std::uint64_t>(fileSize.QuadPart);
+#else
+		fd = ::open(filePath.c_str(), O_RDONLY);
+		if (fd < 0)
+		{
+			throw std::runtime_error("Failed to open file for reading: " + filePath);
+		}
+
+		struct stat st;
+		if (::fstat(fd, &st) != 0)
+		{
+			::close(fd);
+			fd = -1;
+			throw std::runtime_error("Failed to query file size: " + filePath);
+		}
+
+		size = static_cast<std::uint64_t>(st.st_size);
+#endif
+		path = filePath;
+	}
+
+	void InputFile::Close()
+	{
+#ifdef _WIN32
+		if (fileHandle) CloseHandle(static_cast<HANDLE>(fileHandle));
+		fileHandle = nullptr;
+#else
+		if (fd >= 0) ::close(fd);
+		fd = -1;
+#endif
+		path.clear();
+		size = 0;
+	}
+
+	bool InputFile::IsOpen() const
+	{
+#ifdef _WIN32
+		return fileHandle != nullptr;
+#else
+		return fd >= 0;
+#endif
+	}
+
+	std::uint64_t InputFile::Size() const
+	{
+		return size;
+	}
+
+	void InputFile::ReadAt(std::uint64_t offset, std::span<std::uint8_t> out) const
+	{
+		// a single call may return less than asked for, so keep going until out is full
+		std::size_t done = 0;
+		while (done < out.size())
+		{
+			std::uint64_t position = offset + done;
+#ifdef _WIN32
+			DWORD request = static_cast<DWORD>(std::min<std::size_t>(out.size() - done, 1u << 30));
+			OVERLAPPED overlapped{};
+			overlapped.Offset = static_cast<DWORD>(position);
+			overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+			DWORD read = 0;
+			if (!ReadFile(static_cast<HANDLE>(fileHandle), out.data() + done, request, &read, &overlapped) && GetLastError() != ERROR_HANDLE_EOF)
+			{
+				throw std::runtime_error("Failed to read file: " + path);
+			}
+#else
+			ssize_t read = ::pread(fd, out.data() + done, out.size() - done, static_cast<off_t>(position));
+			if (read < 0)
+			{
+				if (errno == EINTR) continue;
+				throw std::runtime_error("Failed to read file: " + path);
+			}
+#endif
+			if (read == 0)
+			{
+				throw std::runtime_error("Unexpected end of file: " + path);
+			}
+			done += static_cast<std::size_t>(read);
+		}
+	}
+
+	void InputFile::CopyTo(std::uint64_t offset, std::uint64_t length, const std::string& outputPath, std::uint64_t at) const
+	{
+#ifdef __linux__
+		int target = ::open(outputPath.c_str(), O_WRONLY);
+		if (target < 0)
+		{
+			throw std::runtime_error("Failed to open file for writing: " + outputPath);
+		}
+
+		// the kernel calls take at most about 2 GiB at once
+		constexpr std::uint64_t MAX_CALL = 1ull << 30;
+		loff_t in = static_cast<loff_t>(offset);
+		loff_t position = static_cast<loff_t>(at);
+		bool copyFileRange = true;
+		while (length > 0)
+		{
+			ssize_t copied;
+			if (copyFileRange)
+			{
+				copied = ::copy_file_range(fd, &in, target, &position, std::min(length, MAX_CALL), 0);
+				if (copied < 0 && errno != EINTR)
+				{
+					// not supported by the kernel or across these filesystems, sendfile still keeps the copy
+					// in the kernel; other errors are left to the buffered copy below to report
+					if (errno != ENOSYS && errno != EXDEV && errno != EINVAL && errno != EOPNOTSUPP) break;
+					copyFileRange = false;
+					continue;
+				}
+			}
+			else
+			{
+				off_t from = static_cast<off_t>(in);
+				if (::lseek(target, static_cast<off_t>(position), SEEK_SET) < 0) break;
+				copied = ::sendfile(target, fd, &from, static_cast<std::size_t>(std::min(length, MAX_CALL)));
+				if (copied > 0)
+				{
+					in = from;
+					position += copied;
+				}
+				if (copied < 0 && errno != EINTR) break;
+			}
+
+			if (copied == 0)
+			{
+				if (static_cast<std::uint64_t>(in) >= Size())
+				{
+					::close(target);
+					throw std::runtime_error("Unexpected end of file: " + path);
+				}
+
+				// some filesystems answer an unsupported copy with 0 instead of an error,
+				// step down to sendfile and then to the buffered copy
+				if (!copyFileRange) break;
+				copyFileRange = false;
+				continue;
+			}
+			if (copied > 0) length -= static_cast<std::uint64_t>(copied);
+		}
+		::close(target);
+
+		offset = static_cast<std::uint64_t>(in);
+		at = static_cast<std::uint64_t>(position);
+		if (length == 0) return;
+#endif
+
+		std::ofstream out{ outputPath, std::ios::binary | std::ios::in | std::ios::out };
+		if (!out)
+		{
+			throw std::runtime_error("Failed to open file for writing: " + outputPath);
+		}
+		out.seekp(static_cast<std::streamoff>(at));
+
+		constexpr std::size_t BUFFER_SIZE = 4 * 1024 * 1024;
+		std::vector<std::uint8_t> buffer(static_cast<std::size_t>(std::min<std::uint64_t>(length, BUFFER_SIZE)));
+		while (length > 0)
+		{
+			std::size_t size = static_cast<std::size_t>(std::min<std::uint64_t>(length, buffer.size()));
+			ReadAt(offset, { buffer.data(), size });
+			if (!out.write(reinterpret_cast<const char*>(buffer.data()), size))
+			{
+				throw std::runtime_error("Failed to write to file: " + outputPath);
+			}
+			offset += size;
+			length -= size;
+		}
+	}
+
+	std::uint64_t Range::Clamp(std::uint64_t fileSize) const
+	{
+		if (offset > fileSize)
+		{
+			throw std::runtime_error("Offset " + std::to_string(offset) + " is past the end of the file (" + std::to_string(fileSize) + " bytes)");
+		}
+		return std::min(length, fileSize - offset);
+	}
+
+	std::vector<std::uint8_t> ReadAll(const std::string& path)
+	{
+		std::ifstream file{ path, std::ios::binary | std::ios::ate };
+		if (!file)
+		{
+			throw std::runtime_error("Failed to open file for reading: " + path);
+		}
+
+		std::streamsize fileSize = file.tellg();
+		file.seekg(0, std::ios::beg);
+
+		std::vector<std::uint8_t> output(static_cast<std::size_t>(fileSize));
+		if (!file.read(reinterpret_cast<char*>(output.data()), fileSize))
+		{
+			throw std::runtime_error("Failed to read file: " + path);
+		}
+
+		return output;
+	}
+
+	std::vector<std::uint8_t> ReadRange(const std::string& path, const Range& range)
+	{
+		InputFile file{ path };
+		std::vector<std::uint8_t> output(static_cast<std::size_t>(range.Clamp(file.Size())));
+		file.ReadAt(range.offset, output);
+		return output;
+	}
+}
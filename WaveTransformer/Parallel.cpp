@@ -0,0 +1,175 @@
+#include "include/Parallel.h"
+
+namespace par
+{
+	namespace
+	{
+		std::atomic<std::size_t> configuredThreads{ 0 };
+
+		// index of the pool queue the calling thread owns, none for threads outside the pool
+		constexpr std::size_t NO_QUEUE = static_cast<std::size_t>(-1);
+		thread_local std::size_t ownQueue = NO_QUEUE;
+	}
+
+	std::size_t ThreadCount()
+	{
+		std::size_t configured = configuredThreads.load();
+		if (configured > 0) return configured;
+
+		unsigned int n = std::thread::hardware_concurrency();
+		return n > 0 ? n : 1;
+	}
+
+	void SetThreadCount(std::size_t threads)
+	{
+		configuredThreads = threads;
+	}
+
+	ThreadPool& Pool()
+	{
+		static ThreadPool pool{ ThreadCount() };
+		return pool;
+	}
+
+	struct ThreadPool::Batch
+	{
+		const std::function<void(std::size_t)>* task;
+		std::atomic<std::size_t> remaining;
+		std::exception_ptr error;
+		std::mutex mutex;
+		std::condition_variable done;
+	};
+
+	ThreadPool::ThreadPool(std::size_t threads)
+	{
+		threads = std::max<std::size_t>(1, threads);
+		for (std::size_t i = 0; i < threads; ++i)
+		{
+			queues.push_back(std::make_unique<Queue>());
+		}
+
+		workers.reserve(threads - 1);
+		for (std::size_t i = 0; i + 1 < threads; ++i)
+		{
+			workers.emplace_back([this, i]() { Work(i); });
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock{ sleepMutex };
+			stopping = true;
+		}
+		wake.notify_all();
+
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	void ThreadPool::Run(std::size_t count, const std::function<void(std::size_t)>& task)
+	{
+		if (count == 0) return;
+
+		Batch batch;
+		batch.task = &task;
+		batch.remaining = count;
+
+		// deal the tasks out in contiguous runs, one run per queue starting with the caller's
+		// own, so neighbouring ranges stay on one thread until someone has to steal them
+		std::size_t home = ownQueue != NO_QUEUE ? ownQueue : queues.size() - 1;
+		std::size_t first = home == queues.size() - 1 ? nextQueue++ % queues.size() : home;
+		std::size_t runs = std::min(count, queues.size());
+		for (std::size_t r = 0; r < runs; ++r)
+		{
+			Queue& queue = *queues[(first + r) % queues.size()];
+			std::lock_guard<std::mutex> lock{ queue.mutex };
+			for (std::size_t i = count * r / runs; i < count * (r + 1) / runs; ++i)
+			{
+				queue.tasks.push_back({ &batch, i });
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock{ sleepMutex };
+			queued += count;
+		}
+		wake.notify_all();
+
+		// help until every task of the batch has been taken, then wait for the ones still running
+		while (batch.remaining.load() > 0)
+		{
+			if (TryRunOne(home)) continue;
+
+			std::unique_lock<std::mutex> lock{ batch.mutex };
+			batch.done.wait(lock, [&]() { return batch.remaining.load() == 0 || queued.load() > 0; });
+		}
+
+		// the last task still holds the mutex while it signals, wait for it to let go
+		std::lock_guard<std::mutex> lock{ batch.mutex };
+		if (batch.error) std::rethrow_exception(batch.error);
+	}
+
+	void ThreadPool::Work(std::size_t worker)
+	{
+		ownQueue = worker;
+		for (;;)
+		{
+			if (TryRunOne(worker)) continue;
+
+			std::unique_lock<std::mutex> lock{ sleepMutex };
+			wake.wait(lock, [this]() { return stopping || queued.load() > 0; });
+			if (stopping) return;
+		}
+	}
+
+	bool ThreadPool::TryRunOne(std::size_t home)
+	{
+		// own queue from the front, then the others from the back
+		for (std::size_t k = 0; k < queues.size(); ++k)
+		{
+			Queue& queue = *queues[(home + k) % queues.size()];
+			std::unique_lock<std::mutex> lock{ queue.mutex };
+			if (queue.tasks.empty()) continue;
+
+			Task task;
+			if (k == 0)
+			{
+				task = queue.tasks.front();
+				queue.tasks.pop_front();
+			}
+			else
+			{
+				task = queue.tasks.back();
+				queue.tasks.pop_back();
+			}
+			lock.unlock();
+
+			--queued;
+			Execute(task);
+			return true;
+		}
+		return false;
+	}
+
+	void ThreadPool::Execute(const Task& task)
+	{
+		Batch& batch = *task.batch;
+		try
+		{
+			(*batch.task)(task.index);
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock{ batch.mutex };
+			if (!batch.error) batch.error = std::current_exception();
+		}
+
+		// counted under the mutex: once Run sees zero and takes the mutex, nothing here touches the batch
+		std::lock_guard<std::mutex> lock{ batch.mutex };
+		if (--batch.remaining == 0)
+			batch.done.notify_all();
+	}
+}
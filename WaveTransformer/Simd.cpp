@@ -0,0 +1,880 @@
+#include "include/Simd.h"
+
+#include <array>
+#include <cstring>
+#include <algorithm>
+#include <numeric>
+
+#if SIMD_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include <immintrin.h>
+#endif
+
+namespace simd
+{
+	bool HasSSSE3()
+	{
+#if SIMD_X86 && defined(_MSC_VER)
+		static const bool supported = []()
+		{
+			int info[4];
+			__cpuid(info, 1);
+			return (info[2] & (1 << 9)) != 0;
+		}();
+		return supported;
+#elif SIMD_X86
+		static const bool supported = __builtin_cpu_supports("ssse3");
+		return supported;
+#else
+		return false;
+#endif
+	}
+
+	bool HasAVX2()
+	{
+#if SIMD_X86 && defined(_MSC_VER)
+		static const bool supported = []()
+		{
+			int info[4];
+			__cpuid(info, 1);
+			bool osxsave = (info[2] & (1 << 27)) != 0;
+			bool avx = (info[2] & (1 << 28)) != 0;
+			if (!osxsave || !avx) return false;
+			// the os has to save the ymm registers
+			if ((_xgetbv(0) & 0x6) != 0x6) return false;
+			__cpuidex(info, 7, 0);
+			return (info[1] & (1 << 5)) != 0;
+		}();
+		return supported;
+#elif SIMD_X86
+		static const bool supported = __builtin_cpu_supports("avx2");
+		return supported;
+#else
+		return false;
+#endif
+	}
+
+	namespace
+	{
+		// for every 8-bit mask: the positions of its set bits, then 0x80 (shuffles in zero)
+		struct CompactTable
+		{
+			std::array<std::array<std::uint8_t, 8>, 256> index{};
+			std::array<std::uint8_t, 256> count{};
+		};
+
+		constexpr CompactTable MakeCompactTable()
+		{
+			CompactTable table;
+			for (int mask = 0; mask < 256; ++mask)
+			{
+				int n = 0;
+				for (int bit = 0; bit < 8; ++bit)
+				{
+					if (mask & (1 << bit)) table.index[mask][n++] = static_cast<std::uint8_t>(bit);
+				}
+				table.count[mask] = static_cast<std::uint8_t>(n);
+				for (int j = n; j < 8; ++j) table.index[mask][j] = 0x80;
+			}
+			return table;
+		}
+
+		constexpr CompactTable compactTable = MakeCompactTable();
+
+		std::size_t CompactBytesScalar(const std::uint8_t* in, const std::uint8_t* mask, std::size_t size, std::uint8_t* out)
+		{
+			std::size_t written = 0;
+			std::size_t groups = size / 8;
+			for (std::size_t g = 0; g < groups; ++g)
+			{
+				const auto& index = compactTable.index[mask[g]];
+				std::uint8_t count = compactTable.count[mask[g]];
+				for (std::uint8_t j = 0; j < count; ++j)
+				{
+					out[written + j] = in[g * 8 + index[j]];
+				}
+				written += count;
+			}
+
+			for (std::size_t i = groups * 8; i < size; ++i)
+			{
+				if ((mask[i / 8] >> (i % 8)) & 1) out[written++] = in[i];
+			}
+			return written;
+		}
+
+#if SIMD_X86
+		SIMD_TARGET("ssse3")
+		std::size_t CompactBytesSSSE3(const std::uint8_t* in, const std::uint8_t* mask, std::size_t size, std::uint8_t* out)
+		{
+			std::size_t groups = size / 8;
+
+			// 8-byte stores may run up to 7 bytes past the last kept byte, so the
+			// final groups that could reach past the output fall back to scalar code
+			std::size_t kept = 0;
+			for (std::size_t g = 0; g < groups; ++g) kept += compactTable.count[mask[g]];
+
+			std::size_t written = 0;
+			std::size_t g = 0;
+			for (; g < groups && written + 8 <= kept; ++g)
+			{
+				__m128i source = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + g * 8));
+				__m128i shuffle = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(compactTable.index[mask[g]].data()));
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(out + written), _mm_shuffle_epi8(source, shuffle));
+				written += compactTable.count[mask[g]];
+			}
+
+			return written + CompactBytesScalar(in + g * 8, mask + g, size - g * 8, out + written);
+		}
+#endif
+	}
+
+	namespace
+	{
+		template<std::size_t Unit>
+		void InterleaveFixed(const std::uint8_t* const* inputs, std::size_t count, std::size_t units, std::uint8_t* out)
+		{
+			for (std::size_t u = 0; u < units; ++u)
+			{
+				for (std::size_t i = 0; i < count; ++i)
+				{
+					std::memcpy(out, inputs[i] + u * Unit, Unit);
+					out += Unit;
+				}
+			}
+		}
+
+		void InterleaveGeneric(const std::uint8_t* const* inputs, std::size_t count, std::size_t unit, std::size_t units, std::uint8_t* out)
+		{
+			switch (unit)
+			{
+			case 1: InterleaveFixed<1>(inputs, count, units, out); break;
+			case 2: InterleaveFixed<2>(inputs, count, units, out); break;
+			case 3: InterleaveFixed<3>(inputs, count, units, out); break;
+			case 4: InterleaveFixed<4>(inputs, count, units, out); break;
+			case 8: InterleaveFixed<8>(inputs, count, units, out); break;
+			default:
+				for (std::size_t u = 0; u < units; ++u)
+				{
+					for (std::size_t i = 0; i < count; ++i)
+					{
+						std::memcpy(out, inputs[i] + u * unit, unit);
+						out += unit;
+					}
+				}
+			}
+		}
+
+#if SIMD_X86
+		template<std::size_t Width>
+		SIMD_TARGET("sse2") inline __m128i UnpackLo(__m128i a, __m128i b)
+		{
+			if constexpr (Width == 1) return _mm_unpacklo_epi8(a, b);
+			else if constexpr (Width == 2) return _mm_unpacklo_epi16(a, b);
+			else if constexpr (Width == 4) return _mm_unpacklo_epi32(a, b);
+			else return _mm_unpacklo_epi64(a, b);
+		}
+
+		template<std::size_t Width>
+		SIMD_TARGET("sse2") inline __m128i UnpackHi(__m128i a, __m128i b)
+		{
+			if constexpr (Width == 1) return _mm_unpackhi_epi8(a, b);
+			else if constexpr (Width == 2) return _mm_unpackhi_epi16(a, b);
+			else if constexpr (Width == 4) return _mm_unpackhi_epi32(a, b);
+			else return _mm_unpackhi_epi64(a, b);
+		}
+
+		// Interleave Count registers of Width byte units. Unpacking neighbouring pairs gives two
+		// half-size problems at twice the width, the low halves come first in the output.
+		template<std::size_t Count, std::size_t Width>
+		SIMD_TARGET("sse2") inline void Transpose(const __m128i* in, __m128i* out)
+		{
+			if constexpr (Count == 1)
+			{
+				out[0] = in[0];
+			}
+			else
+			{
+				__m128i lows[Count / 2];
+				__m128i highs[Count / 2];
+				for (std::size_t p = 0; p < Count / 2; ++p)
+				{
+					lows[p] = UnpackLo<Width>(in[2 * p], in[2 * p + 1]);
+					highs[p] = UnpackHi<Width>(in[2 * p], in[2 * p + 1]);
+				}
+				Transpose<Count / 2, Width * 2>(lows, out);
+				Transpose<Count / 2, Width * 2>(highs, out + Count / 2);
+			}
+		}
+
+		template<std::size_t Count, std::size_t Width>
+		SIMD_TARGET("sse2")
+		void InterleaveSSE2(const std::uint8_t* const* inputs, std::size_t units, std::uint8_t* out)
+		{
+			constexpr std::size_t UNITS_PER_VECTOR = 16 / Width;
+			std::size_t vectors = units / UNITS_PER_VECTOR;
+
+			for (std::size_t v = 0; v < vectors; ++v)
+			{
+				__m128i in[Count];
+				__m128i result[Count];
+				for (std::size_t i = 0; i < Count; ++i)
+				{
+					in[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(inputs[i] + v * 16));
+				}
+				Transpose<Count, Width>(in, result);
+				for (std::size_t i = 0; i < Count; ++i)
+				{
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(out + (v * Count + i) * 16), result[i]);
+				}
+			}
+
+			// leftover units
+			const std::uint8_t* rest[Count];
+			for (std::size_t i = 0; i < Count; ++i) rest[i] = inputs[i] + vectors * 16;
+			InterleaveFixed<Width>(rest, Count, units - vectors * UNITS_PER_VECTOR, out + vectors * Count * 16);
+		}
+
+		template<std::size_t Count>
+		bool TryInterleaveSSE2(const std::uint8_t* const* inputs, std::size_t unit, std::size_t units, std::uint8_t* out)
+		{
+			switch (unit)
+			{
+			case 1: InterleaveSSE2<Count, 1>(inputs, units, out); return true;
+			case 2: if constexpr (Count <= 8) { InterleaveSSE2<Count, 2>(inputs, units, out); return true; } break;
+			case 4: if constexpr (Count <= 4) { InterleaveSSE2<Count, 4>(inputs, units, out); return true; } break;
+			case 8: if constexpr (Count <= 2) { InterleaveSSE2<Count, 8>(inputs, units, out); return true; } break;
+			}
+			return false;
+		}
+#endif
+	}
+
+	void Interleave(const std::uint8_t* const* inputs, std::size_t count, std::size_t unit, std::size_t units, std::uint8_t* out)
+	{
+#if SIMD_X86
+		switch (count)
+		{
+		case 2: if (TryInterleaveSSE2<2>(inputs, unit, units, out)) return; break;
+		case 4: if (TryInterleaveSSE2<4>(inputs, unit, units, out)) return; break;
+		case 8: if (TryInterleaveSSE2<8>(inputs, unit, units, out)) return; break;
+		}
+#endif
+		InterleaveGeneric(inputs, count, unit, units, out);
+	}
+
+#if SIMD_X86
+	namespace
+	{
+		// Float to int32 in the range of the target depth, matching the scalar conversion:
+		// 8 bit is (x + 1) * 0.5 * 255 clamped to [0, 255]; the signed depths scale by 2^(bits-1)
+		// and clamp; for 24 and 32 bit, x >= 1 and x <= -1 give INT32_MAX and INT32_MIN.
+		template<int Bits>
+		SIMD_TARGET("sse2") inline __m128i Quantize(__m128 x)
+		{
+			if constexpr (Bits == 8)
+			{
+				__m128 s = _mm_mul_ps(_mm_mul_ps(_mm_add_ps(x, _mm_set1_ps(1.0f)), _mm_set1_ps(0.5f)), _mm_set1_ps(255.0f));
+				s = _mm_min_ps(_mm_max_ps(s, _mm_set1_ps(0.0f)), _mm_set1_ps(255.0f));
+				return _mm_cvttps_epi32(s);
+			}
+			else
+			{
+				constexpr float scale = static_cast<float>(1u << (Bits - 1));
+				__m128 s = _mm_mul_ps(x, _mm_set1_ps(scale));
+				if constexpr (Bits != 32)
+				{
+					s = _mm_min_ps(_mm_max_ps(s, _mm_set1_ps(-scale)), _mm_set1_ps(scale - 1.0f));
+				}
+				__m128i q = _mm_cvttps_epi32(s);
+				if constexpr (Bits >= 24)
+				{
+					__m128i high = _mm_castps_si128(_mm_cmpge_ps(x, _mm_set1_ps(1.0f)));
+					__m128i low = _mm_castps_si128(_mm_cmple_ps(x, _mm_set1_ps(-1.0f)));
+					q = _mm_or_si128(_mm_andnot_si128(high, q), _mm_and_si128(high, _mm_set1_epi32(0x7FFFFFFF)));
+					q = _mm_or_si128(_mm_andnot_si128(low, q), _mm_and_si128(low, _mm_set1_epi32(static_cast<int>(0x80000000u))));
+				}
+				return q;
+			}
+		}
+
+		// store 8 quantized samples
+		template<int Bits>
+		SIMD_TARGET("sse2") inline void Store(__m128i q0, __m128i q1, std::uint8_t* out)
+		{
+			if constexpr (Bits == 8)
+			{
+				__m128i packed = _mm_packus_epi16(_mm_packs_epi32(q0, q1), _mm_setzero_si128());
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(out), packed);
+			}
+			else if constexpr (Bits == 16)
+			{
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_packs_epi32(q0, q1));
+			}
+			else if constexpr (Bits == 24)
+			{
+				alignas(16) std::int32_t values[8];
+				_mm_store_si128(reinterpret_cast<__m128i*>(values), q0);
+				_mm_store_si128(reinterpret_cast<__m128i*>(values + 4), q1);
+				for (int i = 0; i < 8; ++i)
+				{
+					out[i * 3 + 0] = static_cast<std::uint8_t>(values[i] & 0xFF);
+					out[i * 3 + 1] = static_cast<std::uint8_t>((values[i] >> 8) & 0xFF);
+					out[i * 3 + 2] = static_cast<std::uint8_t>((values[i] >> 16) & 0xFF);
+				}
+			}
+			else
+			{
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out), q0);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16), q1);
+			}
+		}
+
+		template<int Bits>
+		SIMD_TARGET("sse2")
+		std::size_t FloatToPCMSSE2(const float* in, std::size_t count, std::uint8_t* out)
+		{
+			constexpr std::size_t BYTES = Bits / 8;
+			std::size_t i = 0;
+			for (; i + 8 <= count; i += 8)
+			{
+				__m128i q0 = Quantize<Bits>(_mm_loadu_ps(in + i));
+				__m128i q1 = Quantize<Bits>(_mm_loadu_ps(in + i + 4));
+				Store<Bits>(q0, q1, out + i * BYTES);
+			}
+			return i;
+		}
+
+		template<int Bits>
+		SIMD_TARGET("sse2")
+		std::size_t FloatToPCMStereoSSE2(const float* left, const float* right, std::size_t count, std::uint8_t* out)
+		{
+			constexpr std::size_t BYTES = Bits / 8;
+			std::size_t i = 0;
+			for (; i + 4 <= count; i += 4)
+			{
+				__m128i l = Quantize<Bits>(_mm_loadu_ps(left + i));
+				__m128i r = Quantize<Bits>(_mm_loadu_ps(right + i));
+				Store<Bits>(_mm_unpacklo_epi32(l, r), _mm_unpackhi_epi32(l, r), out + i * 2 * BYTES);
+			}
+			return i;
+		}
+
+		template<int Bits>
+		SIMD_TARGET("avx2") inline __m256i Quantize256(__m256 x)
+		{
+			if constexpr (Bits == 8)
+			{
+				__m256 s = _mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(x, _mm256_set1_ps(1.0f)), _mm256_set1_ps(0.5f)), _mm256_set1_ps(255.0f));
+				s = _mm256_min_ps(_mm256_max_ps(s, _mm256_set1_ps(0.0f)), _mm256_set1_ps(255.0f));
+				return _mm256_cvttps_epi32(s);
+			}
+			else
+			{
+				constexpr float scale = static_cast<float>(1u << (Bits - 1));
+				__m256 s = _mm256_mul_ps(x, _mm256_set1_ps(scale));
+				if constexpr (Bits != 32)
+				{
+					s = _mm256_min_ps(_mm256_max_ps(s, _mm256_set1_ps(-scale)), _mm256_set1_ps(scale - 1.0f));
+				}
+				__m256i q = _mm256_cvttps_epi32(s);
+				if constexpr (Bits >= 24)
+				{
+					__m256i high = _mm256_castps_si256(_mm256_cmp_ps(x, _mm256_set1_ps(1.0f), _CMP_GE_OQ));
+					__m256i low = _mm256_castps_si256(_mm256_cmp_ps(x, _mm256_set1_ps(-1.0f), _CMP_LE_OQ));
+					q = _mm256_blendv_epi8(q, _mm256_set1_epi32(0x7FFFFFFF), high);
+					q = _mm256_blendv_epi8(q, _mm256_set1_epi32(static_cast<int>(0x80000000u)), low);
+				}
+				return q;
+			}
+		}
+
+		// store 8 quantized samples. The 24 bit store writes 4 bytes past the 24 it
+		// produces, so callers keep at least one more vector of output ahead
+		template<int Bits>
+		SIMD_TARGET("avx2") inline void Store256(__m256i q, std::uint8_t* out)
+		{
+			if constexpr (Bits == 8)
+			{
+				__m128i words = _mm_packs_epi32(_mm256_castsi256_si128(q), _mm256_extracti128_si256(q, 1));
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(words, _mm_setzero_si128()));
+			}
+			else if constexpr (Bits == 16)
+			{
+				__m128i words = _mm_packs_epi32(_mm256_castsi256_si128(q), _mm256_extracti128_si256(q, 1));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out), words);
+			}
+			else if constexpr (Bits == 24)
+			{
+				// drop the top byte of every sample, 12 packed bytes at the start of each lane
+				const __m256i pack = _mm256_setr_epi8(
+					0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+					0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+				__m256i packed = _mm256_shuffle_epi8(q, pack);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm256_castsi256_si128(packed));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 12), _mm256_extracti128_si256(packed, 1));
+			}
+			else
+			{
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(out), q);
+			}
+		}
+
+		template<int Bits>
+		SIMD_TARGET("avx2")
+		std::size_t FloatToPCMAVX2(const float* in, std::size_t count, std::uint8_t* out)
+		{
+			constexpr std::size_t BYTES = Bits / 8;
+			std::size_t i = 0;
+			for (; i + 16 <= count; i += 8)
+			{
+				Store256<Bits>(Quantize256<Bits>(_mm256_loadu_ps(in + i)), out + i * BYTES);
+			}
+			return i;
+		}
+
+		template<int Bits>
+		SIMD_TARGET("avx2")
+		std::size_t FloatToPCMStereoAVX2(const float* left, const float* right, std::size_t count, std::uint8_t* out)
+		{
+			constexpr std::size_t BYTES = Bits / 8;
+			std::size_t i = 0;
+			for (; i + 16 <= count; i += 8)
+			{
+				__m256i l = Quantize256<Bits>(_mm256_loadu_ps(left + i));
+				__m256i r = Quantize256<Bits>(_mm256_loadu_ps(right + i));
+				// unpack works per 128-bit lane, the permutes put the frames back in order
+				__m256i lo = _mm256_unpacklo_epi32(l, r);
+				__m256i hi = _mm256_unpackhi_epi32(l, r);
+				Store256<Bits>(_mm256_permute2x128_si256(lo, hi, 0x20), out + i * 2 * BYTES);
+				Store256<Bits>(_mm256_permute2x128_si256(lo, hi, 0x31), out + (i + 4) * 2 * BYTES);
+			}
+			return i;
+		}
+
+		SIMD_TARGET("sse2")
+		std::size_t InterleaveFloatStereoSSE2(const float* left, const float* right, std::size_t count, std::uint8_t* out)
+		{
+			std::size_t i = 0;
+			for (; i + 4 <= count; i += 4)
+			{
+				__m128 l = _mm_loadu_ps(left + i);
+				__m128 r = _mm_loadu_ps(right + i);
+				_mm_storeu_ps(reinterpret_cast<float*>(out + i * 8), _mm_unpacklo_ps(l, r));
+				_mm_storeu_ps(reinterpret_cast<float*>(out + i * 8 + 16), _mm_unpackhi_ps(l, r));
+			}
+			return i;
+		}
+
+		SIMD_TARGET("avx2")
+		std::size_t InterleaveFloatStereoAVX2(const float* left, const float* right, std::size_t count, std::uint8_t* out)
+		{
+			std::size_t i = 0;
+			for (; i + 8 <= count; i += 8)
+			{
+				__m256 l = _mm256_loadu_ps(left + i);
+				__m256 r = _mm256_loadu_ps(right + i);
+				__m256 lo = _mm256_unpacklo_ps(l, r);
+				__m256 hi = _mm256_unpackhi_ps(l, r);
+				_mm256_storeu_ps(reinterpret_cast<float*>(out + i * 8), _mm256_permute2f128_ps(lo, hi, 0x20));
+				_mm256_storeu_ps(reinterpret_cast<float*>(out + i * 8 + 32), _mm256_permute2f128_ps(lo, hi, 0x31));
+			}
+			return i;
+		}
+	}
+#endif
+
+	std::size_t FloatToPCM(const float* in, std::size_t count, int bits, std::uint8_t* out)
+	{
+#if SIMD_X86
+		bool avx2 = HasAVX2();
+		switch (bits)
+		{
+		case 8: return avx2 ? FloatToPCMAVX2<8>(in, count, out) : FloatToPCMSSE2<8>(in, count, out);
+		case 16: return avx2 ? FloatToPCMAVX2<16>(in, count, out) : FloatToPCMSSE2<16>(in, count, out);
+		case 24: return avx2 ? FloatToPCMAVX2<24>(in, count, out) : FloatToPCMSSE2<24>(in, count, out);
+		case 32: return avx2 ? FloatToPCMAVX2<32>(in, count, out) : FloatToPCMSSE2<32>(in, count, out);
+		}
+#endif
+		return 0;
+	}
+
+	std::size_t FloatToPCMStereo(const float* left, const float* right, std::size_t count, int bits, std::uint8_t* out)
+	{
+#if SIMD_X86
+		bool avx2 = HasAVX2();
+		switch (bits)
+		{
+		case 8: return avx2 ? FloatToPCMStereoAVX2<8>(left, right, count, out) : FloatToPCMStereoSSE2<8>(left, right, count, out);
+		case 16: return avx2 ? FloatToPCMStereoAVX2<16>(left, right, count, out) : FloatToPCMStereoSSE2<16>(left, right, count, out);
+		case 24: return avx2 ? FloatToPCMStereoAVX2<24>(left, right, count, out) : FloatToPCMStereoSSE2<24>(left, right, count, out);
+		case 32: return avx2 ? FloatToPCMStereoAVX2<32>(left, right, count, out) : FloatToPCMStereoSSE2<32>(left, right, count, out);
+		}
+#endif
+		return 0;
+	}
+
+	std::size_t InterleaveFloatStereo(const float* left, const float* right, std::size_t count, std::uint8_t* out)
+	{
+#if SIMD_X86
+		return HasAVX2() ? InterleaveFloatStereoAVX2(left, right, count, out) : InterleaveFloatStereoSSE2(left, right, count, out);
+#else
+		return 0;
+#endif
+	}
+
+	std::size_t CompactBytes(const std::uint8_t* in, const std::uint8_t* mask, std::size_t size, std::uint8_t* out)
+	{
+#if SIMD_X86
+		if (HasSSSE3()) return CompactBytesSSSE3(in, mask, size, out);
+#endif
+		return CompactBytesScalar(in, mask, size, out);
+	}
+
+	namespace
+	{
+		// PSHUFB control moving the frames of every whole block of blockSize bytes (at most 16) in
+		// a 16 byte vector, frames of frameBytes bytes each: mirrored, or rotated right by one frame.
+		// Bytes past the last whole block stay where they are; span is the number of bytes the
+		// control covers.
+		std::array<std::uint8_t, 16> BlockControl(std::size_t blockSize, std::size_t frameBytes, bool mirror, std::size_t& span)
+		{
+			span = 16 / blockSize * blockSize;
+			std::size_t frames = blockSize / frameBytes;
+			std::array<std::uint8_t, 16> control{};
+			for (std::size_t j = 0; j < 16; ++j)
+			{
+				std::size_t base = j / blockSize * blockSize;
+				std::size_t frame = j % blockSize / frameBytes;
+				std::size_t byte = j % frameBytes;
+				std::size_t to = mirror ? frames - 1 - frame : (frame + frames - 1) % frames;
+				std::size_t from = j >= span ? j : base + to * frameBytes + byte;
+				control[j] = static_cast<std::uint8_t>(from);
+			}
+			return control;
+		}
+
+		// PSHUFB controls for swapping a vector from each end of a block with the frames reversed.
+		// Only the span bytes at the front of the front vector and at the back of the back vector
+		// are whole frames: toFront reverses the back vector's frames into the front span, toBack
+		// the front vector's into the back span, and the bytes outside a span are kept (keep* set).
+		struct ReverseControls
+		{
+			std::array<std::uint8_t, 16> toFront;
+			std::array<std::uint8_t, 16> toBack;
+			std::array<std::uint8_t, 16> keepFront;
+			std::array<std::uint8_t, 16> keepBack;
+			std::size_t span;
+		};
+
+		ReverseControls FrameReverseControls(std::size_t frameBytes)
+		{
+			ReverseControls c{};
+			c.span = 16 / frameBytes * frameBytes;
+			std::size_t frames = c.span / frameBytes;
+			std::size_t lead = 16 - c.span;
+			for (std::size_t j = 0; j < 16; ++j)
+			{
+				bool inFront = j < c.span;
+				c.toFront[j] = inFront ? static_cast<std::uint8_t>(lead + (frames - 1 - j / frameBytes) * frameBytes + j % frameBytes) : 0x80;
+				c.keepFront[j] = inFront ? 0x00 : 0xFF;
+
+				bool inBack = j >= lead;
+				std::size_t k = j - lead;
+				c.toBack[j] = inBack ? static_cast<std::uint8_t>((frames - 1 - k / frameBytes) * frameBytes + k % frameBytes) : 0x80;
+				c.keepBack[j] = inBack ? 0x00 : 0xFF;
+			}
+			return c;
+		}
+
+		// reverse the order of the frames in [front, back), which holds whole frames
+		void ReverseFramesScalar(std::uint8_t* front, std::uint8_t* back, std::size_t frameBytes)
+		{
+			if (frameBytes == 1)
+			{
+				std::reverse(front, back);
+				return;
+			}
+
+			std::uint8_t frame[16];
+			while (back - front >= static_cast<std::ptrdiff_t>(2 * frameBytes))
+			{
+				back -= frameBytes;
+				std::memcpy(frame, front, frameBytes);
+				std::memcpy(front, back, frameBytes);
+				std::memcpy(back, frame, frameBytes);
+				front += frameBytes;
+			}
+		}
+
+		// one memset of a known size per frame, which compiles to a store or two
+		template<std::size_t F>
+		void SilenceScalar(std::uint8_t* data, std::size_t size, std::size_t n, std::size_t first, std::uint8_t silence)
+		{
+			std::size_t frames = size / F;
+			for (std::size_t i = first; i < frames; i += n)
+			{
+				std::memset(data + i * F, silence, F);
+			}
+		}
+
+#if SIMD_X86
+		// Apply control to data vector by vector, span bytes forward each step. Every store stays
+		// inside [data, data + size), so callers on other threads can own the bytes after it.
+		// Returns the bytes done, a multiple of span.
+		SIMD_TARGET("ssse3")
+		std::size_t ShuffleBlocksSSSE3(std::uint8_t* data, std::size_t size, const std::array<std::uint8_t, 16>& control, std::size_t span)
+		{
+			__m128i shuffle = _mm_loadu_si128(reinterpret_cast<const __m128i*>(control.data()));
+			std::size_t i = 0;
+			for (; i + 16 <= size; i += span)
+			{
+				__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), _mm_shuffle_epi8(v, shuffle));
+			}
+			return i;
+		}
+
+		// two 16 byte lanes at once, only for blocks that tile a lane exactly
+		SIMD_TARGET("avx2")
+		std::size_t ShuffleBlocksAVX2(std::uint8_t* data, std::size_t size, const std::array<std::uint8_t, 16>& control)
+		{
+			__m256i shuffle = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(control.data())));
+			std::size_t i = 0;
+			for (; i + 32 <= size; i += 32)
+			{
+				__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), _mm256_shuffle_epi8(v, shuffle));
+			}
+			return i;
+		}
+
+		std::size_t ShuffleBlocks(std::uint8_t* data, std::size_t size, std::size_t blockSize, std::size_t frameBytes, bool mirror)
+		{
+			std::size_t span;
+			std::array<std::uint8_t, 16> control = BlockControl(blockSize, frameBytes, mirror, span);
+
+			std::size_t done = span == 16 && HasAVX2() ? ShuffleBlocksAVX2(data, size, control) : 0;
+			return done + ShuffleBlocksSSSE3(data + done, size - done, control, span);
+		}
+
+		// Reverse the frames of one block by swapping vectors from both ends toward the middle; what
+		// is left in the middle is shorter than two vectors and reversed by the caller.
+		SIMD_TARGET("ssse3")
+		void ReverseSSSE3(std::uint8_t*& front, std::uint8_t*& back, const ReverseControls& c)
+		{
+			const __m128i toFront = _mm_loadu_si128(reinterpret_cast<const __m128i*>(c.toFront.data()));
+			const __m128i toBack = _mm_loadu_si128(reinterpret_cast<const __m128i*>(c.toBack.data()));
+			const __m128i keepFront = _mm_loadu_si128(reinterpret_cast<const __m128i*>(c.keepFront.data()));
+			const __m128i keepBack = _mm_loadu_si128(reinterpret_cast<const __m128i*>(c.keepBack.data()));
+
+			// with a span under 16 each store overlaps the next load, so four vectors from each
+			// end are loaded before any of them is stored to keep the loads off the store buffer
+			std::ptrdiff_t group = static_cast<std::ptrdiff_t>(6 * c.span + 32);
+			while (c.span < 16 && back - front >= group)
+			{
+				__m128i a[4];
+				__m128i b[4];
+				for (std::size_t k = 0; k < 4; ++k)
+				{
+					a[k] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(front + k * c.span));
+					b[k] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(back - 16 - k * c.span));
+				}
+				for (std::size_t k = 0; k < 4; ++k)
+				{
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(front + k * c.span), _mm_or_si128(_mm_shuffle_epi8(b[k], toFront), _mm_and_si128(a[k], keepFront)));
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(back - 16 - k * c.span), _mm_or_si128(_mm_shuffle_epi8(a[k], toBack), _mm_and_si128(b[k], keepBack)));
+				}
+				front += 4 * c.span;
+				back -= 4 * c.span;
+			}
+
+			while (back - front >= 32)
+			{
+				__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(front));
+				__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(back - 16));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(front), _mm_or_si128(_mm_shuffle_epi8(b, toFront), _mm_and_si128(a, keepFront)));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(back - 16), _mm_or_si128(_mm_shuffle_epi8(a, toBack), _mm_and_si128(b, keepBack)));
+				front += c.span;
+				back -= c.span;
+			}
+		}
+
+		// frames that tile a lane only: reverse them within each lane, then swap the lanes
+		SIMD_TARGET("avx2")
+		void ReverseAVX2(std::uint8_t*& front, std::uint8_t*& back, const ReverseControls& c)
+		{
+			const __m256i reverse = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(c.toFront.data())));
+			while (back - front >= 64)
+			{
+				back -= 32;
+				__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(front));
+				__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(back));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(front), _mm256_permute4x64_epi64(_mm256_shuffle_epi8(b, reverse), 0x4E));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(back), _mm256_permute4x64_epi64(_mm256_shuffle_epi8(a, reverse), 0x4E));
+				front += 32;
+			}
+		}
+
+		// Blend the periodic keep/fill pattern (length bytes, a multiple of 32) into data, a vector
+		// at a time. Returns the bytes done.
+		std::size_t SilenceSSE2(std::uint8_t* data, std::size_t size, const std::uint8_t* keep, const std::uint8_t* fill, std::size_t length)
+		{
+			std::size_t i = 0;
+			for (std::size_t at = 0; i + 16 <= size; i += 16, at = at + 16 == length ? 0 : at + 16)
+			{
+				__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+				__m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keep + at));
+				__m128i f = _mm_loadu_si128(reinterpret_cast<const __m128i*>(fill + at));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), _mm_or_si128(_mm_and_si128(v, k), f));
+			}
+			return i;
+		}
+
+		SIMD_TARGET("avx2")
+		std::size_t SilenceAVX2(std::uint8_t* data, std::size_t size, const std::uint8_t* keep, const std::uint8_t* fill, std::size_t length)
+		{
+			std::size_t i = 0;
+			for (std::size_t at = 0; i + 32 <= size; i += 32, at = at + 32 == length ? 0 : at + 32)
+			{
+				__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+				__m256i k = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keep + at));
+				__m256i f = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(fill + at));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), _mm256_or_si256(_mm256_and_si256(v, k), f));
+			}
+			return i;
+		}
+#endif
+	}
+
+	void MirrorBlocks(std::uint8_t* data, std::size_t size, std::size_t blockSize)
+	{
+		MirrorFrames(data, size, 1, blockSize);
+	}
+
+	void RotateBlocksRight(std::uint8_t* data, std::size_t size, std::size_t blockSize)
+	{
+		RotateFramesRight(data, size, 1, blockSize);
+	}
+
+	void MirrorFrames(std::uint8_t* data, std::size_t size, std::size_t frameBytes, std::size_t blockFrames)
+	{
+		if (blockFrames < 2 || frameBytes == 0) return;
+
+		// a trailing partial frame stays where it is
+		size -= size % frameBytes;
+		std::size_t blockSize = blockFrames * frameBytes;
+
+		std::size_t done = 0;
+#if SIMD_X86
+		if (blockSize <= 16 && HasSSSE3())
+		{
+			done = ShuffleBlocks(data, size - size % blockSize, blockSize, frameBytes, true);
+		}
+		else if (blockSize >= 32 && frameBytes <= 16 && HasSSSE3())
+		{
+			ReverseControls controls = FrameReverseControls(frameBytes);
+			bool avx2 = controls.span == 16 && HasAVX2();
+			for (; done < size; done += blockSize)
+			{
+				std::uint8_t* front = data + done;
+				std::uint8_t* back = data + std::min(done + blockSize, size);
+				if (avx2) ReverseAVX2(front, back, controls);
+				ReverseSSSE3(front, back, controls);
+				ReverseFramesScalar(front, back, frameBytes);
+			}
+		}
+#endif
+		for (std::size_t i = done; i < size; i += blockSize)
+		{
+			ReverseFramesScalar(data + i, data + std::min(i + blockSize, size), frameBytes);
+		}
+	}
+
+	void RotateFramesRight(std::uint8_t* data, std::size_t size, std::size_t frameBytes, std::size_t blockFrames)
+	{
+		if (blockFrames < 2 || frameBytes == 0) return;
+
+		size -= size % frameBytes;
+		std::size_t blockSize = blockFrames * frameBytes;
+
+		std::size_t done = 0;
+#if SIMD_X86
+		if (blockSize <= 16 && HasSSSE3())
+		{
+			done = ShuffleBlocks(data, size - size % blockSize, blockSize, frameBytes, false);
+		}
+#endif
+		// memmove moves longer blocks with the widest loads the cpu has
+		std::uint8_t last[16];
+		for (std::size_t i = done; i < size; i += blockSize)
+		{
+			std::size_t length = std::min(blockSize, size - i);
+			if (length < 2 * frameBytes) continue;
+
+			if (frameBytes == 1)
+			{
+				std::uint8_t byte = data[i + length - 1];
+				std::memmove(data + i + 1, data + i, length - 1);
+				data[i] = byte;
+				continue;
+			}
+
+			std::memcpy(last, data + i + length - frameBytes, frameBytes);
+			std::memmove(data + i + frameBytes, data + i, length - frameBytes);
+			std::memcpy(data + i, last, frameBytes);
+		}
+	}
+
+	void SilenceFrames(std::uint8_t* data, std::size_t size, std::size_t frameBytes, std::size_t n, std::size_t first, std::uint8_t silence)
+	{
+		if (n == 0 || frameBytes == 0) return;
+
+		// a trailing partial frame is left as it is
+		size -= size % frameBytes;
+		std::size_t period = n * frameBytes;
+#if SIMD_X86
+		// Patterns repeating within a few frames are blended in from a small table: the
+		// lcm(period, 32) bytes of which bytes to keep and what goes into the others. Sparser
+		// ones store fewer bytes frame by frame.
+		constexpr std::size_t DENSE_PERIOD = 12;
+		std::size_t length = period * 32 / std::gcd(period, std::size_t{ 32 });
+		if (period < DENSE_PERIOD && size >= length)
+		{
+			std::array<std::uint8_t, DENSE_PERIOD * 32> keep;
+			std::array<std::uint8_t, DENSE_PERIOD * 32> fill;
+			std::size_t start = first % n * frameBytes;
+			for (std::size_t j = 0; j < length; ++j)
+			{
+				bool silenced = (j + period - start) % period < frameBytes;
+				keep[j] = silenced ? 0x00 : 0xFF;
+				fill[j] = silenced ? silence : 0x00;
+			}
+
+			std::size_t done = HasAVX2() ? SilenceAVX2(data, size, keep.data(), fill.data(), length) : SilenceSSE2(data, size, keep.data(), fill.data(), length);
+			for (std::size_t i = done; i < size; ++i)
+			{
+				data[i] = static_cast<std::uint8_t>((data[i] & keep[i % length]) | fill[i % length]);
+			}
+			return;
+		}
+#endif
+		switch (frameBytes)
+		{
+		case 1: return SilenceScalar<1>(data, size, n, first, silence);
+		case 2: return SilenceScalar<2>(data, size, n, first, silence);
+		case 3: return SilenceScalar<3>(data, size, n, first, silence);
+		case 4: return SilenceScalar<4>(data, size, n, first, silence);
+		case 6: return SilenceScalar<6>(data, size, n, first, silence);
+		case 8: return SilenceScalar<8>(data, size, n, first, silence);
+		}
+
+		std::size_t frames = size / frameBytes;
+		for (std::size_t i = first; i < frames; i += n)
+		{
+			std::memset(data + i * frameBytes, silence, frameBytes);
+		}
+	}
+}
@@ -0,0 +1,147 @@
+#include "include/Stats.h"
+
+#include <algorithm>
+#include <iomanip>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace stats
+{
+	namespace detail
+	{
+		thread_local Recorder* current = nullptr;
+		thread_local int depth = 0;
+	}
+
+	double ProcessCpuSeconds()
+	{
+#ifdef _WIN32
+		FILETIME creation, exit, kernel, user;
+		if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) return 0.0;
+		auto seconds = [](const FILETIME& time)
+		{
+			// 100 ns ticks
+			return static_cast<double>((static_cast<std::uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime) * 1e-7;
+		};
+		return seconds(kernel) + seconds(user);
+#else
+		rusage usage{};
+		if (getrusage(RUSAGE_SELF, &usage) != 0) return 0.0;
+		return static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) + static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+#endif
+	}
+
+	std::uint64_t PeakRss()
+	{
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters{};
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+		return static_cast<std::uint64_t>(counters.PeakWorkingSetSize);
+#else
+		rusage usage{};
+		if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+		return static_cast<std::uint64_t>(usage.ru_maxrss); // bytes
+#else
+		return static_cast<std::uint64_t>(usage.ru_maxrss) * 1024; // KiB
+#endif
+#endif
+	}
+
+	void Scope::Start(const char* name)
+	{
+		depth = detail::depth++;
+		stage = recorder->Enter(name, depth);
+		cpuStart = ProcessCpuSeconds();
+		start = std::chrono::steady_clock::now();
+	}
+
+	void Scope::Stop()
+	{
+		double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		double cpu = ProcessCpuSeconds() - cpuStart;
+		detail::depth = depth;
+		recorder->Add(stage, wall, cpu, bytesIn, bytesOut, PeakRss());
+	}
+
+	std::size_t Recorder::Enter(const char* name, int depth)
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		auto stage = std::find_if(stages.begin(), stages.end(), [&](const Stage& s) { return s.depth == depth && s.name == name; });
+		if (stage != stages.end()) return static_cast<std::size_t>(stage - stages.begin());
+
+		stages.push_back({ name, depth });
+		return stages.size() - 1;
+	}
+
+	void Recorder::Add(std::size_t index, double wallSeconds, double cpuSeconds, std::uint64_t bytesIn, std::uint64_t bytesOut, std::uint64_t peakRss)
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		Stage& stage = stages[index];
+		++stage.count;
+		stage.wallSeconds += wallSeconds;
+		stage.cpuSeconds += cpuSeconds;
+		stage.bytesIn += bytesIn;
+		stage.bytesOut += bytesOut;
+		stage.peakRss = std::max(stage.peakRss, peakRss);
+	}
+
+	std::vector<Stage> Recorder::Stages() const
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		return stages;
+	}
+
+	void Recorder::PrintTable(std::ostream& out) const
+	{
+		constexpr double MIB = 1024.0 * 1024.0;
+
+		std::ios_base::fmtflags flags = out.flags();
+		std::streamsize precision = out.precision();
+
+		out << "Stats:\n";
+		out << std::left << std::setw(28) << "stage" << std::right << std::setw(7) << "count" << std::setw(11) << "wall ms" << std::setw(11) << "cpu ms"
+			<< std::setw(11) << "in MiB" << std::setw(11) << "out MiB" << std::setw(11) << "MiB/s" << std::setw(11) << "peak MiB" << "\n";
+
+		out << std::fixed << std::setprecision(1);
+		for (const Stage& stage : Stages())
+		{
+			// throughput over whichever side of the stage moved more data
+			std::uint64_t bytes = std::max(stage.bytesIn, stage.bytesOut);
+			out << std::left << std::setw(28) << (std::string(2 * stage.depth, ' ') + stage.name) << std::right << std::setw(7) << stage.count
+				<< std::setw(11) << stage.wallSeconds * 1000.0 << std::setw(11) << stage.cpuSeconds * 1000.0
+				<< std::setw(11) << static_cast<double>(stage.bytesIn) / MIB << std::setw(11) << static_cast<double>(stage.bytesOut) / MIB;
+			if (bytes > 0 && stage.wallSeconds > 0.0)
+				out << std::setw(11) << static_cast<double>(bytes) / MIB / stage.wallSeconds;
+			else
+				out << std::setw(11) << "-";
+			out << std::setw(11) << static_cast<double>(stage.peakRss) / MIB << "\n";
+		}
+		out.flush();
+
+		out.flags(flags);
+		out.precision(precision);
+	}
+
+	void Recorder::WriteJson(std::ostream& out) const
+	{
+		std::vector<Stage> all = Stages();
+		out << "{\n  \"stages\": [";
+		for (std::size_t i = 0; i < all.size(); ++i)
+		{
+			const Stage& stage = all[i];
+			out << (i ? "," : "") << "\n    { \"name\": \"" << stage.name << "\", \"depth\": " << stage.depth << ", \"count\": " << stage.count
+				<< ", \"wall_seconds\": " << stage.wallSeconds << ", \"cpu_seconds\": " << stage.cpuSeconds
+				<< ", \"bytes_in\": " << stage.bytesIn << ", \"bytes_out\": " << stage.bytesOut << ", \"peak_rss_bytes\": " << stage.peakRss << " }";
+		}
+		out << "\n  ]\n}\n";
+	}
+}
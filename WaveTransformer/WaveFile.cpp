@@ -1,4 +1,7 @@
 #include "include/WaveFile.h"
+#include "include/Simd.h"
+
+#include <algorithm>
 
 namespace wf
 {
@@ -16,30 +19,145 @@ namespace wf
 		return data;
 	}
 
-	void wf::WaveFile::WriteOut() const
+	void wf::WaveFile::WriteHeader(std::ostream& file, std::uint64_t dataSize, HeaderLayout layout) const
 	{
 		riffHeader riff;
 		fmtChunk fmt;
 		dataChunkHeader dataHeader;
+		ds64Chunk ds64;
 
-		riff.chunkSize = sizeof(riffHeader) + sizeof(fmtChunk) + sizeof(dataChunkHeader) + static_cast<std::uint32_t>(data.size()) - 8;
 		fmt.audioFormat = static_cast<std::uint16_t>(format);
 		fmt.numChannels = static_cast<std::uint16_t>(channels);
 		fmt.sampleRate = static_cast<std::uint32_t>(sampleRate);
 		fmt.bitsPerSample = static_cast<std::uint16_t>(bps);
 		fmt.byteRate = fmt.sampleRate * fmt.numChannels * fmt.bitsPerSample / 8;
 		fmt.blockAlign = fmt.numChannels * fmt.bitsPerSample / 8;
-		dataHeader.chunkSize = static_cast<std::uint32_t>(data.size());
 
+		if (layout == HeaderLayout::RIFF)
+		{
+			riff.chunkSize = sizeof(riffHeader) + sizeof(fmtChunk) + sizeof(dataChunkHeader) + static_cast<std::uint32_t>(dataSize) - 8;
+			dataHeader.chunkSize = static_cast<std::uint32_t>(dataSize);
+
+			file.write(reinterpret_cast<const char*>(&riff), sizeof(riffHeader));
+			file.write(reinterpret_cast<const char*>(&fmt), sizeof(fmtChunk));
+			file.write(reinterpret_cast<const char*>(&dataHeader), sizeof(dataChunkHeader));
+			return;
+		}
+
+		std::uint64_t riffSize = sizeof(riffHeader) + sizeof(ds64Chunk) + sizeof(fmtChunk) + sizeof(dataChunkHeader) + dataSize - 8;
+
+		if (layout == HeaderLayout::RF64)
+		{
+			// the 32-bit sizes are replaced by the ds64 values
+			std::memcpy(riff.chunkID, "RF64", 4);
+			riff.chunkSize = std::numeric_limits<std::uint32_t>::max();
+			dataHeader.chunkSize = std::numeric_limits<std::uint32_t>::max();
+
+			ds64.riffSize = riffSize;
+			ds64.dataSize = dataSize;
+			ds64.sampleCount = fmt.blockAlign > 0 ? dataSize / fmt.blockAlign : 0;
+		}
+		else
+		{
+			// reserve room for ds64 so the header can be upgraded in place
+			std::memcpy(ds64.chunkID, "JUNK", 4);
+			riff.chunkSize = static_cast<std::uint32_t>(riffSize);
+			dataHeader.chunkSize = static_cast<std::uint32_t>(dataSize);
+		}
+
+		file.write(reinterpret_cast<const char*>(&riff), sizeof(riffHeader));
+		file.write(reinterpret_cast<const char*>(&ds64), sizeof(ds64Chunk));
+		file.write(reinterpret_cast<const char*>(&fmt), sizeof(fmtChunk));
+		file.write(reinterpret_cast<const char*>(&dataHeader), sizeof(dataChunkHeader));
+	}
+
+	wf::WaveFile::Contents wf::WaveFile::Parse(std::span<const std::uint8_t> file)
+	{
+		auto read32 = [&](std::size_t at) { std::uint32_t v; std::memcpy(&v, file.data() + at, sizeof(v)); return v; };
+		auto read16 = [&](std::size_t at) { std::uint16_t v; std::memcpy(&v, file.data() + at, sizeof(v)); return v; };
+		auto read64 = [&](std::size_t at) { std::uint64_t v; std::memcpy(&v, file.data() + at, sizeof(v)); return v; };
+
+		if (file.size() < sizeof(riffHeader) || std::memcmp(file.data() + 8, "WAVE", 4) != 0 ||
+			(std::memcmp(file.data(), "RIFF", 4) != 0 && std::memcmp(file.data(), "RF64", 4) != 0))
+		{
+			throw std::runtime_error("Not a RIFF/RF64 wave file");
+		}
+
+		Contents contents;
+		bool haveFormat = false;
+		std::uint64_t ds64DataSize = 0;
+
+		// every chunk is an id, a 32-bit size and the payload padded to an even length
+		std::size_t at = sizeof(riffHeader);
+		while (at + 8 <= file.size())
+		{
+			const std::uint8_t* id = file.data() + at;
+			std::uint64_t size = read32(at + 4);
+			std::size_t payload = at + 8;
+			std::size_t available = file.size() - payload;
+
+			if (std::memcmp(id, "ds64", 4) == 0 && size >= 24 && available >= 24)
+			{
+				ds64DataSize = read64(payload + 8);
+			}
+			else if (std::memcmp(id, "fmt ", 4) == 0 && size >= 16 && available >= 16)
+			{
+				std::uint16_t formatTag = read16(payload);
+				// WAVE_FORMAT_EXTENSIBLE keeps the actual format in the first two bytes of its sub format guid
+				if (formatTag == 0xFFFE && size >= 26 && available >= 26)
+					formatTag = read16(payload + 24);
+
+				contents.format = static_cast<AudioFormat>(formatTag);
+				contents.channels = static_cast<Channels>(read16(payload + 2));
+				contents.sampleRate = static_cast<SampleRate>(read32(payload + 4));
+				contents.bps = static_cast<BitsPerSample>(read16(payload + 14));
+				haveFormat = true;
+			}
+			else if (std::memcmp(id, "data", 4) == 0)
+			{
+				// RF64 leaves the 32-bit size at its maximum and keeps the real one in ds64
+				if (size == std::numeric_limits<std::uint32_t>::max() && ds64DataSize > 0)
+					size = ds64DataSize;
+
+				if (!haveFormat)
+				{
+					throw std::runtime_error("Wave file has no fmt chunk before its data");
+				}
+
+				contents.dataOffset = payload;
+				// a file cut short (an interrupted recording) keeps the samples it has
+				contents.dataSize = std::min<std::uint64_t>(size, available);
+				return contents;
+			}
+
+			if (size > available) break;
+			at = payload + static_cast<std::size_t>(size + (size & 1));
+		}
+
+		throw std::runtime_error("Wave file has no data chunk");
+	}
+
+	wf::WaveFile::Contents wf::WaveFile::ReadIn()
+	{
+		io::MappedFile file{ path };
+		Contents contents = Parse(file.Span());
+
+		sampleRate = contents.sampleRate;
+		bps = contents.bps;
+		channels = contents.channels;
+		format = contents.format;
+		return contents;
+	}
+
+	void wf::WaveFile::WriteOut() const
+	{
 		std::ofstream file{ path, std::ios::binary | std::ofstream::trunc };
 		if (!file)
 		{
 			throw std::runtime_error("Failed to open file for writing: " + path);
 		}
 		//std::cout << data.size() << " bytes written to " << path << std::endl;
-		file.write(reinterpret_cast<const char*>(&riff), sizeof(riffHeader));
-		file.write(reinterpret_cast<const char*>(&fmt), sizeof(fmtChunk));
-		file.write(reinterpret_cast<const char*>(&dataHeader), sizeof(dataChunkHeader));
+		WriteHeader(file, data.size(), data.size() > MaxRiffDataSize ? HeaderLayout::RF64 : HeaderLayout::RIFF);
 		file.write(reinterpret_cast<const char*>(data.data()), data.size());
 
 		file.close();
@@ -58,6 +176,103 @@ namespace wf
 		file.close();
 	}
 
+	void wf::WaveFile::Open(std::uint64_t expectedSize)
+	{
+		if (stream.is_open())
+		{
+			throw std::runtime_error("WaveFile is already open for streaming: " + path);
+		}
+
+		stream.open(path, std::ios::binary | std::ofstream::trunc);
+		if (!stream)
+		{
+			throw std::runtime_error("Failed to open file for writing: " + path);
+		}
+
+		// a known size picks the final layout up front, otherwise room is kept for ds64.
+		// sizes are patched in Finalize
+		if (expectedSize == UnknownSize)
+			streamLayout = HeaderLayout::Reserved;
+		else
+			streamLayout = expectedSize > MaxRiffDataSize ? HeaderLayout::RF64 : HeaderLayout::RIFF;
+
+		streamedBytes = 0;
+		WriteHeader(stream, 0, streamLayout);
+	}
+
+	void wf::WaveFile::Append(std::span<const std::uint8_t> pcm)
+	{
+		if (!stream.is_open())
+		{
+			throw std::runtime_error("Append called on WaveFile that is not open for streaming: " + path);
+		}
+
+		if (streamLayout == HeaderLayout::RIFF && streamedBytes + pcm.size() > MaxRiffDataSize)
+		{
+			throw std::runtime_error("Streamed data exceeds the size given to Open: " + path);
+		}
+
+		stream.write(reinterpret_cast<const char*>(pcm.data()), pcm.size());
+		if (!stream)
+		{
+			throw std::runtime_error("Failed to write to file: " + path);
+		}
+		streamedBytes += pcm.size();
+	}
+
+	void wf::WaveFile::Append(const io::InputFile& input, std::uint64_t offset, std::uint64_t length)
+	{
+		if (!stream.is_open())
+		{
+			throw std::runtime_error("Append called on WaveFile that is not open for streaming: " + path);
+		}
+
+		if (streamLayout == HeaderLayout::RIFF && streamedBytes + length > MaxRiffDataSize)
+		{
+			throw std::runtime_error("Streamed data exceeds the size given to Open: " + path);
+		}
+
+		// the bytes go in behind the stream's back, so hand over everything buffered first
+		stream.flush();
+		std::uint64_t position = static_cast<std::uint64_t>(stream.tellp());
+		input.CopyTo(offset, length, path, position);
+		stream.seekp(static_cast<std::streamoff>(position + length), std::ios::beg);
+		if (!stream)
+		{
+			throw std::runtime_error("Failed to write to file: " + path);
+		}
+		streamedBytes += length;
+	}
+
+	void wf::WaveFile::Finalize()
+	{
+		if (!stream.is_open())
+		{
+			throw std::runtime_error("Finalize called on WaveFile that is not open for streaming: " + path);
+		}
+
+		// rewrite the header in place now that the data size is known
+		HeaderLayout layout = streamLayout;
+		// the JUNK chunk counts towards the riff size, so a reserved header fills up sooner than a plain one
+		static_assert(sizeof(riffHeader) + sizeof(ds64Chunk) + sizeof(fmtChunk) + sizeof(dataChunkHeader) + MaxReservedDataSize - 8 == std::numeric_limits<std::uint32_t>::max());
+		if (layout == HeaderLayout::Reserved && streamedBytes > MaxReservedDataSize)
+			layout = HeaderLayout::RF64;
+
+		stream.seekp(0, std::ios::beg);
+		WriteHeader(stream, streamedBytes, layout);
+		stream.close();
+
+		if (!stream)
+		{
+			throw std::runtime_error("Failed to finalize file: " + path);
+		}
+	}
+
+	bool wf::WaveFile::IsStreaming() const
+	{
+		return stream.is_open();
+	}
+
 	void wf::WaveFile::SetData(const std::vector<std::uint8_t>& pcm)
 	{
 		data = pcm;
@@ -82,11 +297,14 @@ namespace wf
 			break;
 		case AudioFormat::PCM:
 		{
+			// the simd kernels convert whole vectors, the loops below finish the rest
+			std::size_t done = 0;
 			switch (bps)
 			{
 			case BitsPerSample::BPS_8bit:
 				data.resize(pcm_mono.size() * sizeof(std::uint8_t));
-				for (size_t i = 0; i < pcm_mono.size(); ++i)
+				done = simd::FloatToPCM(pcm_mono.data(), pcm_mono.size(), 8, data.data());
+				for (size_t i = done; i < pcm_mono.size(); ++i)
 				{
 					float sample = pcm_mono[i];
 					data[i] = FloatToPCM<std::uint8_t>(sample, bps);
@@ -94,7 +312,8 @@ namespace wf
 				break;
 			case BitsPerSample::BPS_16bit:
 				data.resize(pcm_mono.size() * sizeof(std::int16_t));
-				for (size_t i = 0; i < pcm_mono.size(); ++i)
+				done = simd::FloatToPCM(pcm_mono.data(), pcm_mono.size(), 16, data.data());
+				for (size_t i = done; i < pcm_mono.size(); ++i)
 				{
 					float sample = pcm_mono[i];
 					std::int16_t intSample = FloatToPCM<std::int16_t>(sample, bps);
@@ -103,7 +322,8 @@ namespace wf
 				break;
 			case BitsPerSample::BPS_24bit:
 				data.resize(pcm_mono.size() * 3); // 3 bytes per sample
-				for (size_t i = 0; i < pcm_mono.size(); ++i)
+				done = simd::FloatToPCM(pcm_mono.data(), pcm_mono.size(), 24, data.data());
+				for (size_t i = done; i < pcm_mono.size(); ++i)
 				{
 					float sample = pcm_mono[i];
 					std::int32_t intSample = FloatToPCM<std::int32_t>(sample, bps);
@@ -114,7 +334,8 @@ namespace wf
 				break;
 			case BitsPerSample::BPS_32bit:
 				data.resize(pcm_mono.size() * sizeof(std::int32_t));
-				for (size_t i = 0; i < pcm_mono.size(); ++i)
+				done = simd::FloatToPCM(pcm_mono.data(), pcm_mono.size(), 32, data.data());
+				for (size_t i = done; i < pcm_mono.size(); ++i)
 				{
 					float sample = pcm_mono[i];
 					std::int32_t intSample = FloatToPCM<std::int32_t>(sample, bps);
@@ -153,7 +374,7 @@ namespace wf
 		{
 		case AudioFormat::FLOAT:
 			data.resize(pcm_left.size() * 2 * sizeof(float));
-			for (size_t i = 0; i < pcm_left.size(); ++i)
+			for (size_t i = simd::InterleaveFloatStereo(pcm_left.data(), pcm_right.data(), pcm_left.size(), data.data()); i < pcm_left.size(); ++i)
 			{
 				std::memcpy(&data[(i * 2) * sizeof(float)], &pcm_left[i], sizeof(float));
 				std::memcpy(&data[(i * 2 + 1) * sizeof(float)], &pcm_right[i], sizeof(float));
@@ -161,11 +382,14 @@ namespace wf
 			break;
 		case AudioFormat::PCM:
 		{
+			// the simd kernels convert whole vectors, the loops below finish the rest
+			std::size_t done = 0;
 			switch (bps)
 			{
 			case BitsPerSample::BPS_8bit:
 				data.resize(pcm_left.size() * 2 * sizeof(std::uint8_t));
-				for (size_t i = 0; i < pcm_left.size(); ++i)
+				done = simd::FloatToPCMStereo(pcm_left.data(), pcm_right.data(), pcm_left.size(), 8, data.data());
+				for (size_t i = done; i < pcm_left.size(); ++i)
 				{
 					// Left channel
 					float sampleL = pcm_left[i];
@@ -178,7 +402,8 @@ namespace wf
 				break;
 			case BitsPerSample::BPS_16bit:
 				data.resize(pcm_left.size() * 2 * sizeof(std::int16_t));
-				for (size_t i = 0; i < pcm_left.size(); ++i)
+				done = simd::FloatToPCMStereo(pcm_left.data(), pcm_right.data(), pcm_left.size(), 16, data.data());
+				for (size_t i = done; i < pcm_left.size(); ++i)
 				{
 					// Left channel
 					float sampleL = pcm_left[i];
@@ -193,7 +418,8 @@ namespace wf
 				break;
 			case BitsPerSample::BPS_24bit:
 				data.resize(pcm_left.size() * 2 * 3); // 3 bytes per sample
-				for (size_t i = 0; i < pcm_left.size(); ++i)
+				done = simd::FloatToPCMStereo(pcm_left.data(), pcm_right.data(), pcm_left.size(), 24, data.data());
+				for (size_t i = done; i < pcm_left.size(); ++i)
 				{
 					// Left channel
 					float sampleL = pcm_left[i];
@@ -212,7 +438,8 @@ namespace wf
 				break;
 			case BitsPerSample::BPS_32bit:
 				data.resize(pcm_left.size() * 2 * sizeof(std::int32_t));
-				for (size_t i = 0; i < pcm_left.size(); ++i)
+				done = simd::FloatToPCMStereo(pcm_left.data(), pcm_right.data(), pcm_left.size(), 32, data.data());
+				for (size_t i = done; i < pcm_left.size(); ++i)
 				{
 					// Left channel
 					float sampleL = pcm_left[i];
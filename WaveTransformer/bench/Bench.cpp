@@ -0,0 +1,354 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../include/Algo.h"
+#include "../include/InputParser.h"
+
+// Throughput of the transforms in Algo.h, the float to pcm conversion and the mp3 helpers on
+// synthetic input. Every result is the best of a few runs, in bytes of input per second, and
+// can be written as JSON to compare builds.
+//
+// wavtrans_bench [--min 64K] [--max 256M] [--mp3max 16M] [--repeat 3] [--filter name] [--json out.json] [--threads N]
+// Input sizes go from min to max in steps of 8x; --max 4G covers the multi-gigabyte range.
+
+namespace
+{
+	struct Settings
+	{
+		std::size_t min = 64 * 1024;
+		std::size_t max = 256 * 1024 * 1024;
+		std::size_t mp3Max = 16 * 1024 * 1024; // the codecs are far slower than the byte transforms
+		int repeat = 3;
+		std::string filter;
+		std::string json;
+	};
+
+	struct Result
+	{
+		std::string name;
+		std::string params;
+		std::size_t bytes;
+		double seconds;
+	};
+
+	// 64K, 16M, 4G, ...
+	std::size_t ParseSize(const std::string& text)
+	{
+		std::size_t end = 0;
+		std::size_t value = static_cast<std::size_t>(std::stoull(text, &end));
+		std::string suffix = text.substr(end);
+		if (suffix == "K" || suffix == "k") return value << 10;
+		if (suffix == "M" || suffix == "m") return value << 20;
+		if (suffix == "G" || suffix == "g") return value << 30;
+		if (!suffix.empty()) throw std::runtime_error("(bench) Invalid size: " + text);
+		return value;
+	}
+
+	std::string FormatSize(std::size_t bytes)
+	{
+		if (bytes >= (std::size_t{ 1 } << 30) && bytes % (std::size_t{ 1 } << 30) == 0) return std::to_string(bytes >> 30) + "G";
+		if (bytes >= (std::size_t{ 1 } << 20) && bytes % (std::size_t{ 1 } << 20) == 0) return std::to_string(bytes >> 20) + "M";
+		if (bytes >= (std::size_t{ 1 } << 10) && bytes % (std::size_t{ 1 } << 10) == 0) return std::to_string(bytes >> 10) + "K";
+		return std::to_string(bytes);
+	}
+
+	// the same pseudo-random bytes on every run, so results compare across builds
+	std::vector<std::uint8_t> Synthetic(std::size_t size)
+	{
+		constexpr std::size_t SEGMENT = 64 * 1024;
+		std::vector<std::uint8_t> data(size);
+		par::ParallelFor((size + SEGMENT - 1) / SEGMENT, [&](std::size_t begin, std::size_t end)
+		{
+			for (std::size_t segment = begin; segment < end; ++segment)
+			{
+				rng::PhiloxStream stream{ 0x5EED, segment };
+				std::size_t stop = std::min(size, (segment + 1) * SEGMENT);
+				for (std::size_t i = segment * SEGMENT; i < stop; ++i)
+				{
+					data[i] = static_cast<std::uint8_t>(stream.Next());
+				}
+			}
+		});
+		return data;
+	}
+
+	class Bench
+	{
+	public:
+		explicit Bench(const Settings& settings) : settings(settings) {}
+
+		bool Wanted(const std::string& name) const
+		{
+			return settings.filter.empty() || name.find(settings.filter) != std::string::npos;
+		}
+
+		// best time of the repeats; prepare runs before each of them and is not timed
+		template<typename Prepare, typename Fn>
+		void Run(const std::string& name, const std::string& params, std::size_t bytes, Prepare&& prepare, Fn&& fn)
+		{
+			if (!Wanted(name)) return;
+
+			double best = std::numeric_limits<double>::infinity();
+			try
+			{
+				for (int r = 0; r < settings.repeat; ++r)
+				{
+					prepare();
+					auto start = std::chrono::steady_clock::now();
+					fn();
+					best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+				}
+			}
+			catch (const std::exception& e)
+			{
+				// one broken benchmark should not cost the rest of the run
+				std::cout << std::left << std::setw(18) << name << std::setw(22) << params << " failed: " << e.what() << std::endl;
+				return;
+			}
+
+			results.push_back({ name, params, bytes, best });
+			std::cout << std::left << std::setw(18) << name << std::setw(22) << params << std::right << std::setw(6) << FormatSize(bytes)
+				<< std::setw(12) << std::fixed << std::setprecision(1) << static_cast<double>(bytes) / best / (1 << 20) << " MiB/s" << std::endl;
+		}
+
+		template<typename Fn>
+		void Run(const std::string& name, const std::string& params, std::size_t bytes, Fn&& fn)
+		{
+			Run(name, params, bytes, []() {}, std::forward<Fn>(fn));
+		}
+
+		void WriteJson(std::ostream& out) const
+		{
+			out << "{\n  \"threads\": " << par::ThreadCount() << ",\n  \"repeat\": " << settings.repeat << ",\n  \"results\": [";
+			for (std::size_t i = 0; i < results.size(); ++i)
+			{
+				const Result& r = results[i];
+				out << (i ? "," : "") << "\n    { \"name\": \"" << r.name << "\", \"params\": \"" << r.params << "\", \"bytes\": " << r.bytes
+					<< ", \"seconds\": " << std::scientific << std::setprecision(6) << r.seconds
+					<< ", \"bytes_per_second\": " << static_cast<double>(r.bytes) / r.seconds << " }";
+			}
+			out << "\n  ]\n}\n";
+		}
+
+	private:
+		const Settings& settings;
+		std::vector<Result> results;
+	};
+
+	void Transforms(Bench& bench, std::span<const std::uint8_t> input)
+	{
+		const std::size_t size = input.size();
+		const algo::WavMetadata wavm{ wf::WaveFile::SampleRate::SR_44100Hz, wf::WaveFile::BitsPerSample::BPS_16bit, wf::WaveFile::Channels::Mono, wf::WaveFile::AudioFormat::PCM };
+		std::vector<std::uint8_t> out;
+		std::vector<std::uint8_t> work(size);
+		auto reset = [&]() { std::memcpy(work.data(), input.data(), size); };
+
+		for (std::size_t blockSize : { 4, 256, 65536 })
+		{
+			bench.Run("ByteBlockShuffle", "s=" + std::to_string(blockSize), size, [&]() { algo::ByteBlockShuffle(input, out, &wavm, blockSize); });
+		}
+
+		for (auto [min, max] : { std::pair<std::size_t, std::size_t>{ 16, 64 }, { 256, 1024 }, { 65536, 262144 } })
+		{
+			bench.Run("ShuffleRange", "x=" + std::to_string(min) + "-" + std::to_string(max), size, [&]() { algo::ShuffleRange(input, out, &wavm, min, max); });
+		}
+
+		for (double p : { 0.1, 0.5, 0.9 })
+		{
+			std::ostringstream params;
+			params << "p=" << p;
+			bench.Run("Dropout", params.str(), size, [&]() { algo::Dropout(input, out, &wavm, p, 1); });
+		}
+
+		for (std::size_t count : { 2, 4 })
+		{
+			for (std::size_t unit : { 1, 2, 3 })
+			{
+				std::vector<std::span<const std::uint8_t>> inputs;
+				for (std::size_t i = 0; i < count; ++i)
+				{
+					inputs.push_back(input.subspan(size * i / count, size * (i + 1) / count - size * i / count));
+				}
+				bench.Run("Interlace", "inputs=" + std::to_string(count) + " u=" + std::to_string(unit), size, [&]() { algo::Interlace(inputs, out, unit); });
+			}
+		}
+
+		// the block-local transforms run in place, as they do when streamed or piped
+		for (std::size_t blockSize : { 2, 256, 65536 })
+		{
+			auto mirror = algo::kernel::ByteMirror(blockSize);
+			bench.Run("ByteMirror", "s=" + std::to_string(blockSize), size, reset, [&]() { mirror.apply(work, 0); });
+			auto swap = algo::kernel::ByteCascadeSwap(blockSize);
+			bench.Run("ByteCascadeSwap", "s=" + std::to_string(blockSize), size, reset, [&]() { swap.apply(work, 0); });
+		}
+
+		for (double p : { 0.001, 0.1, 0.9 })
+		{
+			std::ostringstream params;
+			params << "p=" << p;
+			auto flip = algo::kernel::ByteBitFlip(p, 1);
+			bench.Run("ByteBitFlip", params.str(), size, reset, [&]() { flip.apply(work, 0); });
+		}
+
+		for (std::size_t n : { 2, 7, 1024 })
+		{
+			auto stutter = algo::kernel::Stutter(n);
+			bench.Run("Stutter", "n=" + std::to_string(n), size, reset, [&]() { stutter.apply(work, 0); });
+		}
+
+		// the sample-domain variants, one instantiation per bit depth and channel count
+		for (auto bps : { wf::WaveFile::BitsPerSample::BPS_8bit, wf::WaveFile::BitsPerSample::BPS_16bit, wf::WaveFile::BitsPerSample::BPS_24bit, wf::WaveFile::BitsPerSample::BPS_32bit })
+		{
+			for (auto channels : { wf::WaveFile::Channels::Mono, wf::WaveFile::Channels::Stereo })
+			{
+				std::string format = "b=" + std::to_string(static_cast<int>(bps)) + (channels == wf::WaveFile::Channels::Mono ? " mono" : " stereo");
+				auto mirror = algo::sample::Mirror(256, bps, channels);
+				bench.Run("SampleMirror", format + " s=256", size, reset, [&]() { mirror.apply(work, 0); });
+				auto swap = algo::sample::CascadeSwap(256, bps, channels);
+				bench.Run("SampleCascadeSwap", format + " s=256", size, reset, [&]() { swap.apply(work, 0); });
+				auto stutter = algo::sample::Stutter(7, bps, channels);
+				bench.Run("SampleStutter", format + " n=7", size, reset, [&]() { stutter.apply(work, 0); });
+				auto flip = algo::sample::BitFlip(0.1, 1, bps, channels);
+				bench.Run("SampleBitFlip", format + " p=0.1", size, reset, [&]() { flip.apply(work, 0); });
+			}
+		}
+
+		// what pipe runs for bymir,caswp,stutr
+		auto fused = algo::kernel::Fuse({ algo::kernel::ByteMirror(256), algo::kernel::ByteCascadeSwap(256), algo::kernel::Stutter(7) });
+		bench.Run("Fuse", "bymir+caswp+stutr", size, reset, [&]() { fused.apply(work, 0); });
+	}
+
+	void FloatToPCM(Bench& bench, std::span<const std::uint8_t> input)
+	{
+		if (!bench.Wanted("SetData")) return;
+
+		// samples in [-1.25, 1.25) so clamping is exercised too
+		std::vector<float> samples(input.size() / sizeof(float));
+		for (std::size_t i = 0; i < samples.size(); ++i)
+		{
+			samples[i] = static_cast<float>(input[i]) / 102.4f - 1.25f;
+		}
+		std::vector<float> left(samples.begin(), samples.begin() + samples.size() / 2);
+		std::vector<float> right(samples.begin() + samples.size() / 2, samples.begin() + samples.size() / 2 * 2);
+		std::size_t bytes = samples.size() * sizeof(float);
+
+		for (auto bps : { wf::WaveFile::BitsPerSample::BPS_8bit, wf::WaveFile::BitsPerSample::BPS_16bit, wf::WaveFile::BitsPerSample::BPS_24bit, wf::WaveFile::BitsPerSample::BPS_32bit })
+		{
+			std::string bits = "bps=" + std::to_string(static_cast<int>(bps));
+			wf::WaveFile mono{ "bench.wav", wf::WaveFile::SampleRate::SR_44100Hz, bps, wf::WaveFile::Channels::Mono, wf::WaveFile::AudioFormat::PCM };
+			bench.Run("SetData", bits + " mono", bytes, [&]() { mono.SetData(samples); });
+			wf::WaveFile stereo{ "bench.wav", wf::WaveFile::SampleRate::SR_44100Hz, bps, wf::WaveFile::Channels::Stereo, wf::WaveFile::AudioFormat::PCM };
+			bench.Run("SetData", bits + " stereo", bytes, [&]() { stereo.SetData(left, right); });
+		}
+
+		wf::WaveFile floats{ "bench.wav", wf::WaveFile::SampleRate::SR_44100Hz, wf::WaveFile::BitsPerSample::BPS_32bit, wf::WaveFile::Channels::Stereo, wf::WaveFile::AudioFormat::FLOAT };
+		bench.Run("SetData", "float stereo", bytes, [&]() { floats.SetData(left, right); });
+	}
+
+	// 16-bit stereo noise, the hardest case for the encoder; both directions count pcm bytes
+	void Mp3(Bench& bench, std::span<const std::uint8_t> input)
+	{
+		constexpr auto RATE = wf::WaveFile::SampleRate::SR_44100Hz;
+		constexpr auto BITS = wf::WaveFile::BitsPerSample::BPS_16bit;
+		constexpr auto CHANNELS = wf::WaveFile::Channels::Stereo;
+		constexpr auto FORMAT = wf::WaveFile::AudioFormat::PCM;
+
+		std::vector<std::uint8_t> mp3Data;
+		algo::parallelMp3 = false;
+		bench.Run("WavToMp3", "serial", input.size(), [&]() { mp3Data = algo::util::WavToMp3(input, RATE, BITS, CHANNELS, FORMAT); });
+
+		algo::parallelMp3 = true;
+		std::vector<std::uint8_t> segmented;
+		bench.Run("WavToMp3", "segments", input.size(), [&]() { segmented = algo::util::WavToMp3(input, RATE, BITS, CHANNELS, FORMAT); });
+		algo::parallelMp3 = false;
+
+		if (!bench.Wanted("Mp3ToWav")) return;
+		if (mp3Data.empty())
+		{
+			try
+			{
+				mp3Data = algo::util::WavToMp3(input, RATE, BITS, CHANNELS, FORMAT);
+			}
+			catch (const std::exception&)
+			{
+				// the encoder has reported it, there is nothing to decode
+				return;
+			}
+		}
+
+		std::vector<std::uint8_t> pcm;
+		bench.Run("Mp3ToWav", "", input.size(), [&]() { pcm = algo::util::Mp3ToWav(mp3Data, RATE, BITS, CHANNELS, FORMAT); });
+	}
+}
+
+int main(int argc, char** argv)
+{
+	InputParser parser{ argc, argv };
+	Settings settings;
+
+	try
+	{
+		if (parser.cmdOptionExists("--min")) settings.min = ParseSize(parser.getCmdOption("--min"));
+		if (parser.cmdOptionExists("--max")) settings.max = ParseSize(parser.getCmdOption("--max"));
+		if (parser.cmdOptionExists("--mp3max")) settings.mp3Max = ParseSize(parser.getCmdOption("--mp3max"));
+		if (parser.cmdOptionExists("--repeat")) settings.repeat = std::max(1, std::stoi(parser.getCmdOption("--repeat")));
+		if (parser.cmdOptionExists("--filter")) settings.filter = parser.getCmdOption("--filter");
+		if (parser.cmdOptionExists("--json")) settings.json = parser.getCmdOption("--json");
+		if (parser.cmdOptionExists("--threads")) par::SetThreadCount(static_cast<std::size_t>(std::stoul(parser.getCmdOption("--threads"))));
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Error: " << e.what() << std::endl;
+		return 1;
+	}
+
+	if (settings.min == 0 || settings.min > settings.max)
+	{
+		std::cerr << "Error: --min must be between 1 and --max" << std::endl;
+		return 1;
+	}
+
+	std::vector<std::size_t> sizes;
+	for (std::size_t size = settings.min; size <= settings.max; size *= 8)
+	{
+		sizes.push_back(size);
+		if (size > std::numeric_limits<std::size_t>::max() / 8) break;
+	}
+
+	std::cout << "Threads: " << par::ThreadCount() << ", repeat: " << settings.repeat << std::endl;
+
+	Bench bench{ settings };
+	std::vector<std::uint8_t> data = Synthetic(sizes.back());
+
+	for (std::size_t size : sizes)
+	{
+		std::span<const std::uint8_t> input{ data.data(), size };
+		Transforms(bench, input);
+		FloatToPCM(bench, input);
+		if (size <= settings.mp3Max)
+			Mp3(bench, input);
+	}
+
+	if (!settings.json.empty())
+	{
+		std::ofstream json{ settings.json };
+		if (!json)
+		{
+			std::cerr << "Error: Unable to open " << settings.json << std::endl;
+			return 1;
+		}
+		bench.WriteJson(json);
+		std::cout << "Results written to " << settings.json << std::endl;
+	}
+
+	return 0;
+}
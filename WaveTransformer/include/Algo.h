@@ -8,11 +8,26 @@
 #include <random>
 #include <algorithm>
 #include <iostream>
+#include <span>
+#include <cstring>
+#include <cmath>
+#include <bit>
+#include <functional>
+#include <thread>
 
 #include <lame.h>
 #include <mpg123.h>
 
 #include "WaveFile.h"
+#include "MappedFile.h"
+#include "Kernel.h"
+#include "Sample.h"
+#include "Parallel.h"
+#include "Random.h"
+#include "Simd.h"
+#include "Mp3Frame.h"
+#include "Codec.h"
+#include "Stats.h"
 
 namespace algo
 {
@@ -24,33 +39,43 @@ namespace algo
 		wf::WaveFile::AudioFormat format;
 	};
 
-	extern bool convertMp3;
-	extern bool mpg124_verbose;
+	// per thread, so concurrent batch jobs each see their own settings
+	extern thread_local bool convertMp3;
+	extern thread_local bool mpg124_verbose;
+	extern thread_local bool parallelMp3;
+	// byte range of every input file to work on, the whole file by default
+	extern thread_local io::Range inputRange;
+	// inputs are wave files: work on the samples of their data chunk, with inputRange taken within it
+	extern thread_local bool wavInput;
+	// where progress lines go, std::cout unless a batch job collects its own to print in one piece
+	extern thread_local std::ostream* report;
 
 	namespace util
 	{
-		inline std::vector<std::uint8_t> WavToMp3(const std::vector<std::uint8_t>& wavData, wf::WaveFile::SampleRate sampleRate, wf::WaveFile::BitsPerSample bps, wf::WaveFile::Channels channels, wf::WaveFile::AudioFormat format)
+		// Input bytes handed to an algorithm: a zero-copy view of the mapped input file,
+		// or an owned buffer when the data had to be converted first (mp3).
+		class AudioSource
+		{
+		public:
+			AudioSource() = default;
+			explicit AudioSource(io::MappedFile&& mapped) : file(std::move(mapped)), view(file.Span()) {}
+			AudioSource(io::MappedFile&& mapped, std::size_t offset, std::size_t size) : file(std::move(mapped)), view(file.Span().subspan(offset, size)) {}
+			explicit AudioSource(std::vector<std::uint8_t>&& data) : buffer(std::move(data)), view(buffer) {}
+
+			std::span<const std::uint8_t> Span() const { return view; }
+			const std::uint8_t* Data() const { return view.data(); }
+			std::size_t Size() const { return view.size(); }
+			bool Empty() const { return view.empty(); }
+
+		private:
+			io::MappedFile file;
+			std::vector<std::uint8_t> buffer;
+			std::span<const std::uint8_t> view;
+		};
+
+		// Encode all of wavData with lame and flush it. The mp3 bytes are handed to sink as they come out.
+		inline void EncodeMp3(lame_t lame, std::span<const std::uint8_t> wavData, wf::WaveFile::BitsPerSample bps, wf::WaveFile::Channels channels, wf::WaveFile::AudioFormat format, const std::function<void(std::span<const std::uint8_t>)>& sink)
 		{
-			lame_t lame = lame_init();
-			if (!lame)
-			{
-				std::cerr << "(algo::util::WavToMp3) Error: Unable to initialize LAME encoder" << std::endl;
-				throw std::runtime_error("(algo::util::WavToMp3) LAME initialization failed");
-			}
-
-			lame_set_in_samplerate(lame, static_cast<int>(sampleRate));
-			lame_set_num_channels(lame, static_cast<int>(channels));
-			lame_set_VBR(lame, vbr_default);
-			//lame_set_quality(lame, 5);
-			if (lame_init_params(lame) < 0)
-			{
-				std::cerr << "(algo::util::WavToMp3) Error: Unable to set LAME parameters" << std::endl;
-				lame_close(lame);
-				throw std::runtime_error("(algo::util::WavToMp3) LAME parameter initialization failed");
-			}
-
-			std::vector<std::uint8_t> mp3Data;
-
 			const int PCM_BUFFER_SIZE = 16384;
 			const int MP3_BUFFER_SIZE = 16384;
 
@@ -80,18 +105,16 @@ namespace algo
 				else
 				{
 					std::cerr << "(algo::util::WavToMp3) Error: Unsupported audio format" << std::endl;
-					lame_close(lame);
 					throw std::runtime_error("(algo::util::WavToMp3) Unsupported audio format");
 				}	
 
 				if (mp3Bytes < 0)
 				{
 					std::cerr << "(algo::util::WavToMp3) Error: LAME encoding failed" << std::endl;
-					lame_close(lame);
 					throw std::runtime_error("(algo::util::WavToMp3) LAME encoding error");
 				}
 
-				mp3Data.insert(mp3Data.end(), mp3Buffer.begin(), mp3Buffer.begin() + mp3Bytes);
+				if (mp3Bytes > 0) sink({ mp3Buffer.data(), static_cast<std::size_t>(mp3Bytes) });
 			}
 
 			// Flush LAME buffer
@@ -99,66 +122,141 @@ namespace algo
 			if (mp3Bytes < 0)
 			{
 				std::cerr << "(algo::util::WavToMp3) Error: LAME flush failed" << std::endl;
-				lame_close(lame);
 				throw std::runtime_error("(algo::util::WavToMp3) LAME flush error");
 			}
-			if(mp3Bytes > 0) mp3Data.insert(mp3Data.end(), mp3Buffer.begin(), mp3Buffer.begin() + mp3Bytes);
-
-			lame_close(lame);
+			if(mp3Bytes > 0) sink({ mp3Buffer.data(), static_cast<std::size_t>(mp3Bytes) });
+		}
 
+		inline std::vector<std::uint8_t> EncodeMp3(lame_t lame, std::span<const std::uint8_t> wavData, wf::WaveFile::BitsPerSample bps, wf::WaveFile::Channels channels, wf::WaveFile::AudioFormat format)
+		{
+			std::vector<std::uint8_t> mp3Data;
+			EncodeMp3(lame, wavData, bps, channels, format, [&mp3Data](std::span<const std::uint8_t> mp3)
+			{
+				mp3Data.insert(mp3Data.end(), mp3.begin(), mp3.end());
+			});
 			return mp3Data;
 		}
 
-		inline std::vector<std::uint8_t> Mp3ToWav(const std::vector<std::uint8_t>& mp3Data, wf::WaveFile::SampleRate sampleRate, wf::WaveFile::BitsPerSample bps, wf::WaveFile::Channels channels, wf::WaveFile::AudioFormat format)
+		// frames of input each segment encoder gets from its neighbours on both sides, so the
+		// MDCT overlap and psychoacoustic state at its first and last kept frame match a serial encode
+		constexpr std::size_t MP3_SEGMENT_OVERLAP = 2;
+		// smallest segment worth its own encoder, in frames (about 3 s at 44.1 kHz)
+		constexpr std::size_t MP3_MIN_SEGMENT_FRAMES = 128;
+
+		// Encode contiguous segments of wavData on separate LAME instances and splice the frames.
+		// Segments start on the encoder's frame grid, so segment frame j is the same frame of the
+		// input as in a serial encode; the frames encoded from the overlap are dropped again.
+		// Returns an empty vector when the input is too short to split or the output cannot be
+		// cut at frame boundaries, and the caller encodes serially.
+		inline std::vector<std::uint8_t> EncodeMp3Segments(std::span<const std::uint8_t> wavData, wf::WaveFile::SampleRate sampleRate, wf::WaveFile::BitsPerSample bps, wf::WaveFile::Channels channels, wf::WaveFile::AudioFormat format)
 		{
-			mpg123_init();
-
-			mpg123_handle* mh = mpg123_new(nullptr, nullptr);
-			if (!mh)
+			std::size_t frameSamples;
+			bool resampled;
 			{
-				std::cerr << "(algo::util::Mp3ToWav) Error: Unable to initialize mpg123 decoder" << std::endl;
-				throw std::runtime_error("(algo::util::Mp3ToWav) mpg123 initialization failed");
+				codec::Encoder probe{ sampleRate, channels, true };
+				frameSamples = static_cast<std::size_t>(lame_get_framesize(probe.Get()));
+				resampled = lame_get_out_samplerate(probe.Get()) != static_cast<int>(sampleRate);
 			}
 
-			long rate = static_cast<long>(sampleRate);
-			int ch = static_cast<int>(channels);
+			// the frame grid is only a whole number of input samples when lame does not resample
+			std::size_t bytesPerFrame = frameSamples * static_cast<std::size_t>(channels) * (static_cast<std::size_t>(bps) / 8);
+			if (resampled || bytesPerFrame == 0) return {};
 
-			int encoding;
-			if (format == wf::WaveFile::AudioFormat::PCM && bps == wf::WaveFile::BitsPerSample::BPS_16bit)
-				encoding = MPG123_ENC_SIGNED_16;
-			else if (format == wf::WaveFile::AudioFormat::FLOAT && bps == wf::WaveFile::BitsPerSample::BPS_32bit)
-				encoding = MPG123_ENC_FLOAT_32;
-			else
+			std::size_t totalFrames = wavData.size() / bytesPerFrame;
+			std::size_t segments = std::min(par::ThreadCount(), totalFrames / MP3_MIN_SEGMENT_FRAMES);
+			if (segments < 2) return {};
+
+			struct Segment
 			{
-				std::cerr << "(algo::util::Mp3ToWav) Error: Unsupported audio format or bits per sample" << std::endl;
-				mpg123_delete(mh);
-				throw std::runtime_error("(algo::util::Mp3ToWav) Unsupported audio format or bits per sample");
+				std::vector<std::uint8_t> mp3;
+				std::size_t begin = 0, end = 0; // kept bytes of mp3
+				bool ok = false;
+			};
+			std::vector<Segment> parts(segments);
+
+			par::ParallelFor(segments, [&](std::size_t first, std::size_t last)
+			{
+				for (std::size_t s = first; s < last; ++s)
+				{
+					std::size_t frameBegin = s * totalFrames / segments;
+					std::size_t frameEnd = (s + 1) * totalFrames / segments;
+					bool lastSegment = s + 1 == segments;
+
+					std::size_t lead = std::min(frameBegin, MP3_SEGMENT_OVERLAP);
+					std::size_t byteBegin = (frameBegin - lead) * bytesPerFrame;
+					std::size_t byteEnd = lastSegment ? wavData.size() : std::min(wavData.size(), (frameEnd + MP3_SEGMENT_OVERLAP) * bytesPerFrame);
+
+					Segment& part = parts[s];
+					part.mp3 = EncodeMp3(codec::Encoder{ sampleRate, channels, true }.Get(), wavData.subspan(byteBegin, byteEnd - byteBegin), bps, channels, format);
+
+					std::vector<std::size_t> frames = mp3::FrameOffsets(part.mp3);
+					std::size_t keep = frameEnd - frameBegin;
+					if (frames.size() < lead + keep) continue;
+
+					part.begin = frames[lead];
+					part.end = lastSegment || lead + keep == frames.size() ? part.mp3.size() : frames[lead + keep];
+					part.ok = true;
+				}
+			});
+
+			std::size_t total = 0;
+			for (const Segment& part : parts)
+			{
+				if (!part.ok)
+				{
+					std::cerr << "(algo::util::WavToMp3) Warning: Unable to split encoder output at frame boundaries, encoding serially" << std::endl;
+					return {};
+				}
+				total += part.end - part.begin;
 			}
 
-			mpg123_format_none(mh);
-			mpg123_format(mh, rate, ch, encoding);
-			if(!mpg124_verbose) mpg123_param(mh, MPG123_ADD_FLAGS, MPG123_QUIET, 0);
+			std::vector<std::uint8_t> mp3Data(total);
+			std::size_t pos = 0;
+			for (const Segment& part : parts)
+			{
+				std::memcpy(mp3Data.data() + pos, part.mp3.data() + part.begin, part.end - part.begin);
+				pos += part.end - part.begin;
+			}
+			return mp3Data;
+		}
+
+		inline std::vector<std::uint8_t> WavToMp3(std::span<const std::uint8_t> wavData, wf::WaveFile::SampleRate sampleRate, wf::WaveFile::BitsPerSample bps, wf::WaveFile::Channels channels, wf::WaveFile::AudioFormat format)
+		{
+			stats::Scope scope{ "mp3 encode" };
+			scope.BytesIn(wavData.size());
+
+			std::vector<std::uint8_t> mp3Data;
+			if (parallelMp3)
+				mp3Data = EncodeMp3Segments(wavData, sampleRate, bps, channels, format);
 
-			if (mpg123_open_feed(mh) != MPG123_OK)
+			if (mp3Data.empty())
 			{
-				std::cerr << "(algo::util::Mp3ToWav) Error: Unable to open mpg123 feed" << std::endl;
-				mpg123_delete(mh);
-				throw std::runtime_error("(algo::util::Mp3ToWav) mpg123 open feed failed");
+				codec::Encoder encoder{ sampleRate, channels, false };
+				mp3Data = EncodeMp3(encoder.Get(), wavData, bps, channels, format);
 			}
 
-			std::vector<std::uint8_t> pcmData;
+			scope.BytesOut(mp3Data.size());
+			return mp3Data;
+		}
+
+		inline int Mp3Encoding(wf::WaveFile::BitsPerSample bps, wf::WaveFile::AudioFormat format)
+		{
+			if (format == wf::WaveFile::AudioFormat::PCM && bps == wf::WaveFile::BitsPerSample::BPS_16bit)
+				return MPG123_ENC_SIGNED_16;
+			else if (format == wf::WaveFile::AudioFormat::FLOAT && bps == wf::WaveFile::BitsPerSample::BPS_32bit)
+				return MPG123_ENC_FLOAT_32;
+
+			std::cerr << "(algo::util::Mp3ToWav) Error: Unsupported audio format or bits per sample" << std::endl;
+			throw std::runtime_error("(algo::util::Mp3ToWav) Unsupported audio format or bits per sample");
+		}
+
+		// Read everything mh can decode from what it has been fed so far and hand it to sink
+		inline void ReadMp3(mpg123_handle* mh, const std::function<void(std::span<const std::uint8_t>)>& sink)
+		{
 			std::size_t bytesDone = 0;
 			const std::size_t bufferSize = 16384;
 			std::vector<std::uint8_t> buffer(bufferSize);
 
-			if (mpg123_feed(mh, mp3Data.data(), mp3Data.size()) != MPG123_OK)
-			{
-				std::cerr << "(algo::util::Mp3ToWav) Error: Unable to feed mp3 data to mpg123" << std::endl;
-				mpg123_close(mh);
-				mpg123_delete(mh);
-				throw std::runtime_error("(algo::util::Mp3ToWav) mpg123 feed failed");
-			}
-
 			int err;
 			while (true)
 			{
@@ -170,21 +268,22 @@ namespace algo
 					int ch, enc;
 					mpg123_getformat(mh, &rate, &ch, &enc);
 
-					std::cout << "(algo::util::Mp3ToWav) Warning: New format - Rate: " << rate << ", Channels: " << ch << ", Encoding: " << enc << std::endl;
+					*report << "(algo::util::Mp3ToWav) Warning: New format - Rate: " << rate << ", Channels: " << ch << ", Encoding: " << enc << std::endl;
 
 					continue;
 				}
 
 				if (err == MPG123_OK)
 				{
-					pcmData.insert(pcmData.end(), buffer.begin(), buffer.begin() + bytesDone);
+					if (bytesDone > 0)
+						sink({ buffer.data(), bytesDone });
 					continue;
 				}
 
 				if (err == MPG123_DONE || err == MPG123_NEED_MORE)
 				{
 					if (bytesDone > 0)
-						pcmData.insert(pcmData.end(), buffer.begin(), buffer.begin() + bytesDone);
+						sink({ buffer.data(), bytesDone });
 					break;
 				}
 
@@ -193,158 +292,640 @@ namespace algo
 
 				std::cerr << "(algo::util::Mp3ToWav) Error: mpg123 read failed (" << err << ')' << std::endl;
 				std::cerr << "mpg123 error: " << msg << std::endl;
-				mpg123_close(mh);
-				mpg123_delete(mh);
 				throw std::runtime_error("(algo::util::Mp3ToWav) mpg123 read error");
 			}
-			
+		}
+
+		// Decode all of mp3Data on a freshly opened mh. reserve is the expected pcm size.
+		inline std::vector<std::uint8_t> DecodeMp3(mpg123_handle* mh, std::span<const std::uint8_t> mp3Data, std::size_t reserve)
+		{
+			std::vector<std::uint8_t> pcmData;
+			pcmData.reserve(reserve);
+
+			if (mpg123_feed(mh, mp3Data.data(), mp3Data.size()) != MPG123_OK)
+			{
+				std::cerr << "(algo::util::Mp3ToWav) Error: Unable to feed mp3 data to mpg123" << std::endl;
+				throw std::runtime_error("(algo::util::Mp3ToWav) mpg123 feed failed");
+			}
 
-			mpg123_close(mh);
-			mpg123_delete(mh);
-			mpg123_exit();
+			ReadMp3(mh, [&pcmData](std::span<const std::uint8_t> pcm)
+			{
+				pcmData.insert(pcmData.end(), pcm.begin(), pcm.end());
+			});
 
 			return pcmData;
 		}
 
+		// frames decoded and dropped before a range on top of the bit reservoir lookback, so the
+		// decoder has synced and rebuilt the overlap-add and synthesis state of the frame before it
+		constexpr std::size_t MP3_DECODE_PRELUDE = 2;
+		// smallest range worth its own decoder, in frames (about 7 s at 44.1 kHz)
+		constexpr std::size_t MP3_MIN_DECODE_FRAMES = 256;
+
+		// Decode contiguous frame ranges of the stream on separate handles, straight into one
+		// pre-sized buffer. A range's decoder is fed from the earliest frame whose main data the
+		// first kept frame (or the one before it) reaches through the bit reservoir, minus a prelude,
+		// and frames before the range are dropped by number, so every kept frame is decoded from the
+		// same state as in a serial decode. Returns an empty vector when the stream does not allow
+		// this (short, LAME/Xing tag, changing format, trailing data) and the caller decodes serially.
+		inline std::vector<std::uint8_t> DecodeMp3Ranges(std::span<const std::uint8_t> mp3Data, const mp3::FrameIndex& index, wf::WaveFile::SampleRate sampleRate, wf::WaveFile::Channels channels, int encoding, std::size_t bytesPerSample)
+		{
+			const std::vector<std::size_t>& frames = index.offsets;
+			std::size_t ranges = std::min(par::ThreadCount(), frames.size() / MP3_MIN_DECODE_FRAMES);
+			if (ranges < 2) return {};
+
+			// gapless info in the tag trims the output, leave that to a serial decode
+			if (mp3::IsInfoFrame(mp3Data.data() + frames.front(), index.first)) return {};
+
+			// only an ID3v1 tag may follow the frames
+			std::size_t trailing = mp3Data.size() - index.end;
+			if (trailing != 0 && !(trailing == 128 && std::memcmp(mp3Data.data() + index.end, "TAG", 3) == 0)) return {};
+
+			// reach[k]: first frame holding main data of frame k
+			std::vector<std::size_t> reach(frames.size());
+			std::vector<std::size_t> mainData(frames.size());
+			for (std::size_t k = 0; k < frames.size(); ++k)
+			{
+				mp3::FrameHeader header;
+				mp3::ParseFrameHeader(mp3Data.data() + frames[k], mp3Data.size() - frames[k], header);
+				if (header.sampleRate != static_cast<int>(sampleRate) || header.samples != index.first.samples) return {};
+
+				mainData[k] = mp3::MainDataSize(header);
+				std::size_t back = mp3::MainDataBegin(mp3Data.data() + frames[k], header);
+				std::size_t j = k;
+				for (std::size_t available = 0; available < back && j > 0; available += mainData[j])
+				{
+					--j;
+				}
+				reach[k] = j;
+			}
+
+			std::size_t frameBytes = index.first.samples * static_cast<std::size_t>(channels) * bytesPerSample;
+			std::vector<std::uint8_t> pcmData(frames.size() * frameBytes);
+			std::vector<char> complete(ranges, 0);
+			// read on this thread, the workers have their own copy of the thread_local
+			bool verbose = mpg124_verbose;
+
+			par::ParallelFor(ranges, [&](std::size_t firstRange, std::size_t lastRange)
+			{
+				for (std::size_t r = firstRange; r < lastRange; ++r)
+				{
+					std::size_t begin = r * frames.size() / ranges;
+					std::size_t end = (r + 1) * frames.size() / ranges;
+
+					std::size_t from = begin;
+					if (begin > 0)
+					{
+						from = std::min({ reach[begin], reach[begin - 1], begin - 1 });
+						from = from > MP3_DECODE_PRELUDE ? from - MP3_DECODE_PRELUDE : 0;
+					}
+					// one frame past the range, in case the decoder looks at the next header
+					std::size_t feedEnd = end + 1 < frames.size() ? frames[end + 1] : index.end;
+
+					codec::Decoder decoder{ sampleRate, channels, encoding, verbose };
+					mpg123_handle* mh = decoder.Get();
+					if (mpg123_feed(mh, mp3Data.data() + frames[from], feedEnd - frames[from]) != MPG123_OK) continue;
+
+					std::size_t decoded = 0;
+					while (true)
+					{
+						off_t num = 0;
+						unsigned char* audio = nullptr;
+						std::size_t bytes = 0;
+						int err = mpg123_decode_frame(mh, &num, &audio, &bytes);
+
+						if (err == MPG123_NEW_FORMAT) continue;
+						if (err != MPG123_OK) break;
+
+						std::size_t frame = from + static_cast<std::size_t>(num);
+						if (frame < begin || frame >= end) continue;
+						if (bytes != frameBytes) break;
+
+						std::memcpy(pcmData.data() + frame * frameBytes, audio, bytes);
+						++decoded;
+					}
+
+					complete[r] = decoded == end - begin;
+				}
+			});
+
+			if (std::find(complete.begin(), complete.end(), 0) != complete.end())
+			{
+				std::cerr << "(algo::util::Mp3ToWav) Warning: Frame ranges did not decode cleanly, decoding serially" << std::endl;
+				return {};
+			}
+
+			return pcmData;
+		}
+
+		inline std::vector<std::uint8_t> Mp3ToWav(std::span<const std::uint8_t> mp3Data, wf::WaveFile::SampleRate sampleRate, wf::WaveFile::BitsPerSample bps, wf::WaveFile::Channels channels, wf::WaveFile::AudioFormat format)
+		{
+			int encoding = Mp3Encoding(bps, format);
+			std::size_t bytesPerSample = static_cast<std::size_t>(bps) / 8;
+
+			stats::Scope scope{ "mp3 decode" };
+			scope.BytesIn(mp3Data.size());
+
+			mp3::FrameIndex index = mp3::IndexFrames(mp3Data);
+			std::vector<std::uint8_t> pcmData = DecodeMp3Ranges(mp3Data, index, sampleRate, channels, encoding, bytesPerSample);
+			if (pcmData.empty())
+			{
+				std::size_t reserve = index.offsets.size() * index.first.samples * static_cast<std::size_t>(channels) * bytesPerSample;
+				codec::Decoder decoder{ sampleRate, channels, encoding, mpg124_verbose };
+				pcmData = DecodeMp3(decoder.Get(), mp3Data, reserve);
+			}
+
+			scope.BytesOut(pcmData.size());
+			return pcmData;
+		}
+
+		// read-only input, mapped without copying (or converted to mp3)
+		// the bytes of inputFile to work on: inputRange, taken within the data chunk with wavInput
+		io::Range InputRange(const std::string& inputFile, const std::string& algoName);
+
+		AudioSource GetAudioSource(const std::string& inputFile, const std::string& algoName, const WavMetadata* wavm, bool ignoreMp3 = false);
+		std::vector<AudioSource> GetAudioSource(const std::vector<std::string>& inputFiles, const std::string& algoName, const WavMetadata* wavm, bool ignoreMp3 = false);
+		// writable input, filled by a single bulk read (or converted to mp3)
 		std::vector<std::uint8_t> GetAudioData(const std::string& inputFile, const std::string& algoName, const WavMetadata* wavm, bool ignoreMp3 = false);
-		std::vector<std::vector<std::uint8_t>> GetAudioData(const std::vector<std::string>& inputFiles, const std::string& algoName, const WavMetadata* wavm, bool ignoreMp3 = false);
 		void ReturnAudioData(std::vector<uint8_t>& audioData, const WavMetadata* wavm);
+
+		// what --bytealign rounds block sizes to: bps/8 bytes, or 1 without it
+		inline std::size_t Alignment(const WavMetadata* wavm, bool align)
+		{
+			std::size_t byteAlign = static_cast<std::size_t>(wavm->bps) / 8;
+			return align && byteAlign > 0 ? byteAlign : 1;
+		}
 	}
 
-	inline void Reinterpret(const std::string& inputFile, std::vector<std::uint8_t>& audioData)
+	// window size for chunked execution, rounded down to the kernel granularity
+	constexpr std::size_t CHUNK_SIZE = 4 * 1024 * 1024;
+
+	// chunks in flight between two stages of the mp3 pipeline
+	constexpr std::size_t PIPELINE_DEPTH = 16;
+	// encoded bytes gathered into one chunk, and the least the kernel stage runs over at once
+	constexpr std::size_t PIPELINE_CHUNK = 64 * 1024;
+	constexpr std::size_t PIPELINE_WINDOW = 256 * 1024;
+
+	// The mp3 round trip for a block-local kernel: the LAME encoder, the kernel and the mpg123
+	// decoder each run on their own thread, linked by bounded queues, so the stages overlap and
+	// neither the whole mp3 stream nor the whole decoded output is ever held in memory. The kernel
+	// sees the encoded stream in windows at their stream offsets, the same bytes it would change
+	// running over the whole encoded file.
+	inline void RunMp3Pipeline(const std::string& inputFile, wf::WaveFile& waveFile, const kernel::BlockKernel& k, const std::string& algoName, const WavMetadata* wavm)
 	{
-		std::cout << "Input: " << inputFile << std::endl;
+		// fail before any work is done if mpg123 cannot produce the output format
+		int encoding = util::Mp3Encoding(wavm->bps, wavm->format);
 
-		audioData = util::GetAudioData(inputFile, "Reinterpret", nullptr, true);
+		util::AudioSource input = util::GetAudioSource(inputFile, algoName, wavm, true);
+
+		par::BoundedQueue<std::vector<std::uint8_t>> encoded{ PIPELINE_DEPTH };
+		par::BoundedQueue<std::vector<std::uint8_t>> transformed{ PIPELINE_DEPTH };
+		std::exception_ptr encodeError, transformError;
+
+		// the stages overlap, each thread reports its own beneath the caller's scope
+		stats::Recorder* recorder = stats::Current();
+		int depth = stats::Depth();
+
+		std::thread encoder([&]()
+		{
+			stats::Session session{ recorder, depth };
+			try
+			{
+				stats::Scope scope{ "mp3 encode" };
+				scope.BytesIn(input.Size());
+				std::vector<std::uint8_t> chunk;
+				codec::Encoder lame{ wavm->sampleRate, wavm->channels, false };
+				util::EncodeMp3(lame.Get(), input.Span(), wavm->bps, wavm->channels, wavm->format,
+					[&](std::span<const std::uint8_t> mp3)
+				{
+					chunk.insert(chunk.end(), mp3.begin(), mp3.end());
+					scope.BytesOut(mp3.size());
+					if (chunk.size() < PIPELINE_CHUNK) return;
+					if (!encoded.Push(std::move(chunk)))
+						throw std::runtime_error("(algo::" + algoName + ") Pipeline stopped");
+					chunk = {};
+				});
+				if (!chunk.empty()) encoded.Push(std::move(chunk));
+			}
+			catch (...)
+			{
+				encodeError = std::current_exception();
+			}
+			encoded.Close();
+		});
+
+		std::thread transformer([&]()
+		{
+			stats::Session session{ recorder, depth };
+			try
+			{
+				// windows handed to the kernel are a multiple of its granularity, except the last
+				std::vector<std::uint8_t> window;
+				std::uint64_t offset = 0;
+				while (auto chunk = encoded.Pop())
+				{
+					window.insert(window.end(), chunk->begin(), chunk->end());
+
+					std::size_t ready = window.size() / k.granularity * k.granularity;
+					if (ready < PIPELINE_WINDOW) continue;
+
+					std::vector<std::uint8_t> rest(window.begin() + ready, window.end());
+					window.resize(ready);
+					{
+						stats::Scope scope{ "transform" };
+						scope.BytesIn(ready);
+						scope.BytesOut(ready);
+						k.apply(window, offset);
+					}
+					offset += ready;
+					if (!transformed.Push(std::move(window))) break;
+					window = std::move(rest);
+				}
+
+				if (!window.empty())
+				{
+					{
+						stats::Scope scope{ "transform" };
+						scope.BytesIn(window.size());
+						scope.BytesOut(window.size());
+						k.apply(window, offset);
+					}
+					transformed.Push(std::move(window));
+				}
+			}
+			catch (...)
+			{
+				transformError = std::current_exception();
+				encoded.Close();
+			}
+			transformed.Close();
+		});
+
+		auto stop = [&]()
+		{
+			encoded.Close();
+			transformed.Close();
+			encoder.join();
+			transformer.join();
+		};
+
+		try
+		{
+			codec::Decoder decoder{ wavm->sampleRate, wavm->channels, encoding, mpg124_verbose };
+			mpg123_handle* mh = decoder.Get();
+
+			// the decoded size is about the input size; above half the RIFF limit leave room for RF64
+			std::uint64_t expected = input.Size() <= wf::WaveFile::MaxRiffDataSize / 2 ? input.Size() : wf::WaveFile::UnknownSize;
+			waveFile.Open(expected);
+
+			while (auto chunk = transformed.Pop())
+			{
+				stats::Scope scope{ "mp3 decode" };
+				scope.BytesIn(chunk->size());
+				if (mpg123_feed(mh, chunk->data(), chunk->size()) != MPG123_OK)
+				{
+					std::cerr << "(algo::util::Mp3ToWav) Error: Unable to feed mp3 data to mpg123" << std::endl;
+					throw std::runtime_error("(algo::util::Mp3ToWav) mpg123 feed failed");
+				}
+
+				util::ReadMp3(mh, [&waveFile, &scope](std::span<const std::uint8_t> pcm)
+				{
+					scope.BytesOut(pcm.size());
+					stats::Scope write{ "write" };
+					write.BytesOut(pcm.size());
+					waveFile.Append(pcm);
+				});
+			}
+		}
+		catch (...)
+		{
+			stop();
+			throw;
+		}
+		stop();
+
+		if (encodeError) std::rethrow_exception(encodeError);
+		if (transformError) std::rethrow_exception(transformError);
+
+		waveFile.Finalize();
 	}
 
-	inline void Interlace(const std::vector<std::string>& inputFiles, std::vector<std::uint8_t>& audioData, const WavMetadata* wavm)
+	// Stream the input through a block-local kernel window by window and straight into
+	// the output wave file, so memory use stays at one window whatever the input size.
+	// With mp3 conversion the windows go through the encoder/decoder pipeline instead.
+	inline void RunChunked(const std::string& inputFile, wf::WaveFile& waveFile, const kernel::BlockKernel& k, const std::string& algoName, const WavMetadata* wavm)
 	{
-		std::cout << "Inputs: \n";
-		for (const auto& file : inputFiles)
+		*report << "Input: " << inputFile << std::endl;
+
+		if (convertMp3)
 		{
-			std::cout << file << "\n";
+			RunMp3Pipeline(inputFile, waveFile, k, algoName, wavm);
+			return;
 		}
-		std::cout << std::endl;
 
-		// interlace the data from multiple input files into audioData
-		// append 0s if files are of unequal length
-		std::vector<std::vector<std::uint8_t>> fileData = util::GetAudioData(inputFiles, "Interlace", wavm);
-		size_t maxSize = std::max_element(fileData.begin(), fileData.end(), [](const auto& a, const auto& b) {return a.size() < b.size(); })->size();
-		
-		// Interlace data
-		for (size_t pos = 0; pos < maxSize; ++pos)
+		io::InputFile input;
+		try
+		{
+			input.Open(inputFile);
+		}
+		catch (const std::runtime_error&)
+		{
+			std::cerr << "(algo::" << algoName << ") Error: Unable to open input file: " << inputFile << std::endl;
+			throw std::runtime_error("(algo::" + algoName + ") Failed to open input file");
+		}
+
+		io::Range range = util::InputRange(inputFile, algoName);
+		std::uint64_t total = range.Clamp(input.Size());
+
+		std::size_t windowSize = std::max<std::size_t>(1, CHUNK_SIZE / k.granularity) * k.granularity;
+		std::vector<std::uint8_t> window(static_cast<std::size_t>(std::min<std::uint64_t>(windowSize, total)));
+
+		waveFile.Open(total);
+		for (std::uint64_t offset = 0; offset < total; offset += windowSize)
 		{
-			for (size_t fileIdx = 0; fileIdx < fileData.size(); ++fileIdx)
+			std::size_t size = static_cast<std::size_t>(std::min<std::uint64_t>(windowSize, total - offset));
 			{
-				if (pos < fileData[fileIdx].size())
+				stats::Scope scope{ "read" };
+				scope.BytesIn(size);
+				try
 				{
-					audioData.push_back(fileData[fileIdx][pos]);
+					input.ReadAt(range.offset + offset, { window.data(), size });
 				}
-				else
+				catch (const std::runtime_error&)
 				{
-					audioData.push_back(0); // padding with 0 if this file is shorter
+					std::cerr << "(algo::" << algoName << ") Error: Unable to read input file: " << inputFile << std::endl;
+					throw std::runtime_error("(algo::" + algoName + ") Failed to read input file");
 				}
 			}
+
+			std::span<std::uint8_t> view{ window.data(), size };
+			{
+				stats::Scope scope{ "transform" };
+				scope.BytesIn(size);
+				scope.BytesOut(size);
+				k.apply(view, offset);
+			}
+
+			stats::Scope scope{ "write" };
+			scope.BytesOut(size);
+			waveFile.Append(view);
 		}
+		waveFile.Finalize();
+	}
 
-		util::ReturnAudioData(audioData, wavm);
+	// Write the header and then the input bytes as they are. The payload is copied file to file,
+	// in the kernel where the platform allows, so it never passes through audioData.
+	inline void Reinterpret(const std::string& inputFile, wf::WaveFile& waveFile)
+	{
+		*report << "Input: " << inputFile << std::endl;
+
+		io::InputFile input;
+		try
+		{
+			input.Open(inputFile);
+		}
+		catch (const std::runtime_error&)
+		{
+			std::cerr << "(algo::Reinterpret) Error: Unable to open input file: " << inputFile << std::endl;
+			throw std::runtime_error("(algo::Reinterpret) Failed to open input file");
+		}
+
+		io::Range range = util::InputRange(inputFile, "Reinterpret");
+		std::uint64_t total = range.Clamp(input.Size());
+		*report << "Audio data size: " << total << " bytes" << std::endl;
+
+		stats::Scope scope{ "copy" };
+		scope.BytesIn(total);
+		scope.BytesOut(total);
+		waveFile.Open(total);
+		waveFile.Append(input, range.offset, total);
+		waveFile.Finalize();
 	}
 
-	// Byte Block Shuffling: Divide data into blocks and randomly shuffle their order
-	inline void ByteBlockShuffle(const std::string& inputFile, std::vector<std::uint8_t>& audioData, const WavMetadata* wavm, std::size_t blockSize = 256, bool align = false)
+	// interlace the inputs into audioData, unit bytes at a time
+	// append 0s if inputs are of unequal length
+	inline void Interlace(const std::vector<std::span<const std::uint8_t>>& inputs, std::vector<std::uint8_t>& audioData, std::size_t unit = 1)
 	{
-		std::cout << "Input: " << inputFile << std::endl;
+		if (inputs.empty() || unit == 0)
+		{
+			std::cerr << "(algo::Interlace) Error: needs at least one input and a unit of at least one byte" << std::endl;
+			throw std::runtime_error("(algo::Interlace) Invalid inputs or unit");
+		}
+
+		size_t maxSize = std::max_element(inputs.begin(), inputs.end(), [](const auto& a, const auto& b) {return a.size() < b.size(); })->size();
+		size_t minSize = std::min_element(inputs.begin(), inputs.end(), [](const auto& a, const auto& b) {return a.size() < b.size(); })->size();
 
-		audioData = util::GetAudioData(inputFile, "ByteBlockShuffle", wavm);
+		const std::size_t count = inputs.size();
+		const std::size_t stride = unit * count;
+		const std::size_t maxUnits = (maxSize + unit - 1) / unit;
+		const std::size_t fullUnits = minSize / unit;
 
-		if (blockSize == 0 || audioData.empty()) return;
+		audioData.clear();
+		audioData.resize(maxUnits * stride);
 
-		if (align)
+		// Interlace data while every input has a full unit, split across threads by output range
+		par::ParallelFor(fullUnits, [&](std::size_t begin, std::size_t end)
 		{
-			// round block size to nearest multiple of  bps/8
-			std::size_t byteAlign = static_cast<std::size_t>(wavm->bps) / 8;
-			if (byteAlign > 0)
+			std::vector<const std::uint8_t*> starts(count);
+			for (std::size_t i = 0; i < count; ++i)
 			{
-				blockSize = ((blockSize + byteAlign - 1) / byteAlign) * byteAlign;
+				starts[i] = inputs[i].data() + begin * unit;
+			}
+			simd::Interleave(starts.data(), count, unit, end - begin, audioData.data() + begin * stride);
+		}, 64 * 1024);
+
+		// padding with 0 where an input is shorter, the output is already zeroed
+		for (std::size_t u = fullUnits; u < maxUnits; ++u)
+		{
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				std::size_t start = u * unit;
+				if (start < inputs[i].size())
+				{
+					std::size_t size = std::min(unit, inputs[i].size() - start);
+					std::memcpy(audioData.data() + u * stride + i * unit, inputs[i].data() + start, size);
+				}
 			}
 		}
+	}
+
+	inline void Interlace(const std::vector<std::string>& inputFiles, std::vector<std::uint8_t>& audioData, const WavMetadata* wavm, std::size_t unit = 1)
+	{
+		*report << "Inputs: \n";
+		for (const auto& file : inputFiles)
+		{
+			*report << file << "\n";
+		}
+		*report << std::endl;
+
+		if (inputFiles.empty() || unit == 0)
+		{
+			std::cerr << "(algo::Interlace) Error: needs at least one input and a unit of at least one byte" << std::endl;
+			throw std::runtime_error("(algo::Interlace) Invalid inputs or unit");
+		}
 
-		std::size_t numBlocks = (audioData.size() + blockSize - 1) / blockSize;
-		std::vector<std::vector<std::uint8_t>> blocks(numBlocks);
+		std::vector<util::AudioSource> fileData = util::GetAudioSource(inputFiles, "Interlace", wavm);
+		std::vector<std::span<const std::uint8_t>> inputs;
+		inputs.reserve(fileData.size());
+		for (const auto& source : fileData)
+		{
+			inputs.push_back(source.Span());
+		}
+		Interlace(inputs, audioData, unit);
+
+		util::ReturnAudioData(audioData, wavm);
+	}
 
-		// Split data into blocks
+	// Byte Block Shuffling: Divide data into blocks and randomly shuffle their order
+	inline void ByteBlockShuffle(std::span<const std::uint8_t> input, std::vector<std::uint8_t>& audioData, const WavMetadata* wavm, std::size_t blockSize = 256, bool align = false)
+	{
+		if (blockSize == 0 || input.empty())
+		{
+			audioData.assign(input.begin(), input.end());
+			return;
+		}
+
+		blockSize = kernel::AlignBlockSize(blockSize, util::Alignment(wavm, align));
+
+		// Shuffle block indices, only the last block may be short
+		std::size_t numBlocks = (input.size() + blockSize - 1) / blockSize;
+		std::vector<std::size_t> order(numBlocks);
 		for (std::size_t i = 0; i < numBlocks; ++i)
 		{
-			std::size_t start = i * blockSize;
-			std::size_t end = std::min(start + blockSize, audioData.size());
-			blocks[i].assign(audioData.begin() + start, audioData.begin() + end);
+			order[i] = i;
 		}
 
-		// Shuffle blocks
 		std::random_device rd;
 		std::mt19937 g(rd());
-		std::shuffle(blocks.begin(), blocks.end(), g);
+		std::shuffle(order.begin(), order.end(), g);
 
-		// Reassemble audioData
-		audioData.clear();
-		for (const auto& block : blocks)
+		// Gather blocks into the output in shuffled order
+		audioData.resize(input.size());
+		kernel::GatherBlocks(input, audioData.data(), numBlocks, [&](std::size_t i)
 		{
-			audioData.insert(audioData.end(), block.begin(), block.end());
-		}
-
-		util::ReturnAudioData(audioData, wavm);
+			std::size_t start = order[i] * blockSize;
+			return kernel::Block{ start, std::min(blockSize, input.size() - start) };
+		});
 	}
 
-	inline void ShuffleRange(const std::string& inputFile, std::vector<std::uint8_t>& audioData, const WavMetadata* wavm, std::size_t minSize = 256, std::size_t maxSize = 1024, bool align = false)
+	inline void ByteBlockShuffle(const std::string& inputFile, std::vector<std::uint8_t>& audioData, const WavMetadata* wavm, std::size_t blockSize = 256, bool align = false)
 	{
-		std::cout << "Input: " << inputFile << std::endl;
+		*report << "Input: " << inputFile << std::endl;
 
-		audioData = util::GetAudioData(inputFile, "ShuffleRange", wavm);
+		util::AudioSource source = util::GetAudioSource(inputFile, "ByteBlockShuffle", wavm);
+		ByteBlockShuffle(source.Span(), audioData, wavm, blockSize, align);
 
-		if (maxSize == 0 || minSize == 0 || audioData.empty()) return;
+		util::ReturnAudioData(audioData, wavm);
+	}
+
+	inline void ShuffleRange(std::span<const std::uint8_t> input, std::vector<std::uint8_t>& audioData, const WavMetadata* wavm, std::size_t minSize = 256, std::size_t maxSize = 1024, bool align = false)
+	{
+		if (maxSize == 0 || minSize == 0 || input.empty())
+		{
+			audioData.assign(input.begin(), input.end());
+			return;
+		}
 		if (minSize > maxSize)
 		{
 			std::cerr << "(algo::ShuffleRange) Error: min greater than max" << std::endl;
 			throw std::runtime_error{ "(algo::ShuffleRange) Error: min greater than max" };
 		}
 
+		using kernel::Block;
+
+		// block sizes are drawn in fixed slices, each with its own generator, so the
+		// table can be filled in parallel without depending on the thread count
+		constexpr std::size_t SLICE = 65536;
+
 		std::random_device rd;
 		std::mt19937 g(rd());
-		std::uniform_int_distribution<std::size_t> distrib{ minSize, maxSize };
 
-		std::vector<std::vector<std::uint8_t>> blocks;
+		const std::size_t total = input.size();
+		const double mean = (static_cast<double>(minSize) + static_cast<double>(maxSize)) / 2.0;
+		const double deviation = (static_cast<double>(maxSize) - static_cast<double>(minSize)) / std::sqrt(12.0);
+		const double expected = static_cast<double>(total) / mean;
 
-		// Split data into blocks
-		std::size_t start = 0;
-		while ( start < audioData.size() )
+		std::vector<Block> blocks;
+		std::size_t covered = 0;
+
+		// Split data into blocks, a few sigma over the expected count covers the input
+		// almost always; the loop tops up the table otherwise
+		while (covered < total)
 		{
-			std::size_t blockSize = distrib(g);
+			std::size_t first = blocks.size();
+			std::size_t count = first == 0
+				? static_cast<std::size_t>(expected + 6.0 * std::sqrt(expected) * deviation / mean) + 1
+				: SLICE;
+			std::size_t slices = (count + SLICE - 1) / SLICE;
+
+			std::vector<std::uint32_t> seeds(slices);
+			for (auto& seed : seeds) seed = g();
+
+			std::vector<std::size_t> sliceBytes(slices);
+			blocks.resize(first + count);
 
-			if (align)
+			par::ParallelFor(slices, [&](std::size_t begin, std::size_t end)
 			{
-				// round block size to nearest multiple of  bps/8
-				std::size_t byteAlign = static_cast<std::size_t>(wavm->bps) / 8;
-				if (byteAlign > 0)
+				std::uniform_int_distribution<std::size_t> distrib{ minSize, maxSize };
+				for (std::size_t slice = begin; slice < end; ++slice)
 				{
-					blockSize = ((blockSize + byteAlign - 1) / byteAlign) * byteAlign;
+					std::mt19937 sliceGen(seeds[slice]);
+					std::size_t from = first + slice * SLICE;
+					std::size_t to = std::min(from + SLICE, blocks.size());
+					std::size_t bytes = 0;
+					for (std::size_t i = from; i < to; ++i)
+					{
+						std::size_t blockSize = kernel::AlignBlockSize(distrib(sliceGen), util::Alignment(wavm, align));
+						blocks[i].length = blockSize;
+						bytes += blockSize;
+					}
+					sliceBytes[slice] = bytes;
 				}
+			});
+
+			// exclusive scan over the slices, then over the blocks within each slice
+			for (std::size_t slice = 0; slice < slices; ++slice)
+			{
+				std::size_t bytes = sliceBytes[slice];
+				sliceBytes[slice] = covered;
+				covered += bytes;
 			}
 
-			std::size_t end = std::min(start + blockSize, audioData.size());
-			blocks.emplace_back().assign(audioData.begin() + start, audioData.begin() + end);
-			start += blockSize;
+			par::ParallelFor(slices, [&](std::size_t begin, std::size_t end)
+			{
+				for (std::size_t slice = begin; slice < end; ++slice)
+				{
+					std::size_t offset = sliceBytes[slice];
+					std::size_t from = first + slice * SLICE;
+					std::size_t to = std::min(from + SLICE, blocks.size());
+					for (std::size_t i = from; i < to; ++i)
+					{
+						blocks[i].offset = offset;
+						offset += blocks[i].length;
+					}
+				}
+			});
 		}
-		
+
+		// drop the blocks past the end and cut the last one short
+		auto past = std::partition_point(blocks.begin(), blocks.end(), [total](const Block& b) { return b.offset < total; });
+		blocks.erase(past, blocks.end());
+		blocks.back().length = std::min(blocks.back().length, total - blocks.back().offset);
+
 		// Shuffle blocks
 		std::shuffle(blocks.begin(), blocks.end(), g);
 
-		// Reassemble audioData
-		audioData.clear();
-		for (const auto& block : blocks)
-		{
-			audioData.insert(audioData.end(), block.begin(), block.end());
-		}
+		// Gather blocks into a pre-sized output
+		audioData.resize(total);
+		kernel::GatherBlocks(input, audioData.data(), blocks.size(), [&](std::size_t i) { return blocks[i]; });
+	}
+
+	inline void ShuffleRange(const std::string& inputFile, std::vector<std::uint8_t>& audioData, const WavMetadata* wavm, std::size_t minSize = 256, std::size_t maxSize = 1024, bool align = false)
+	{
+		*report << "Input: " << inputFile << std::endl;
+
+		util::AudioSource source = util::GetAudioSource(inputFile, "ShuffleRange", wavm);
+		ShuffleRange(source.Span(), audioData, wavm, minSize, maxSize, align);
 
 		util::ReturnAudioData(audioData, wavm);
 	}
@@ -352,76 +933,27 @@ namespace algo
 	// Byte Mirror: For each block of blockSize, reverse the order of bytes within the block
 	inline void ByteMirror(const std::string& inputFile, std::vector<std::uint8_t>& audioData, const WavMetadata* wavm, std::size_t blockSize = 256, bool align = false)
 	{
-		std::vector<std::uint8_t> buffer = util::GetAudioData(inputFile, "ByteMirror", wavm);
-		audioData.clear();
-		audioData.reserve(buffer.size());
+		audioData = util::GetAudioData(inputFile, "ByteMirror", wavm);
 
-		if (align)
-		{
-			// round block size to nearest multiple of  bps/8
-			std::size_t byteAlign = static_cast<std::size_t>(wavm->bps) / 8;
-			if (byteAlign > 0)
-			{
-				blockSize = ((blockSize + byteAlign - 1) / byteAlign) * byteAlign;
-			}
-		}
-
-		std::size_t total = buffer.size();
-		for (std::size_t i = 0; i < total; i += blockSize)
-		{
-			std::size_t end = std::min(i + blockSize, total);
-			// Copy and reverse the block
-			for (std::size_t j = 0; j < end - i; ++j)
-			{
-				audioData.push_back(buffer[end - 1 - j]);
-			}
-		}
+		kernel::ByteMirror(blockSize, util::Alignment(wavm, align)).apply(audioData, 0);
 
 		util::ReturnAudioData(audioData, wavm);
 	}
 
-	inline void ByteBitFlip(const std::string& inputFile, std::vector<std::uint8_t>& audioData, const WavMetadata* wavm, double flipProbability = 0.1)
+	inline void ByteBitFlip(const std::string& inputFile, std::vector<std::uint8_t>& audioData, const WavMetadata* wavm, double flipProbability = 0.1, std::uint64_t seed = 0)
 	{
 		audioData = util::GetAudioData(inputFile, "ByteBitFlip", wavm);
 
-		std::random_device rd;
-		std::mt19937 gen(rd());
-		std::uniform_real_distribution<> prob(0.0, 1.0);
-		std::uniform_int_distribution<> bit(0, 7);
-
-		for (auto& b : audioData)
-		{
-			if (prob(gen) < flipProbability)
-			{
-				b ^= (1 << bit(gen));
-			}
-		}
+		kernel::ByteBitFlip(flipProbability, seed).apply(audioData, 0);
 
 		util::ReturnAudioData(audioData, wavm);
 	}
 
-	inline void ByteCascadeSwap(const std::string& inputFile, std::vector<std::uint8_t>& audioData, const WavMetadata* wavm, std::size_t blockSize = 256)
+	inline void ByteCascadeSwap(const std::string& inputFile, std::vector<std::uint8_t>& audioData, const WavMetadata* wavm, std::size_t blockSize = 256, bool align = false)
 	{
-		std::vector<std::uint8_t> buffer = util::GetAudioData(inputFile, "ByteCascadeSwap", wavm);
-		audioData.clear();
-		audioData.reserve(buffer.size());
+		audioData = util::GetAudioData(inputFile, "ByteCascadeSwap", wavm);
 
-		std::size_t total = buffer.size();
-		for (std::size_t i = 0; i < total; i += blockSize)
-		{
-			std::size_t end = std::min(i + blockSize, total);
-			if (end - i > 1)
-			{
-				// Shift block right by one
-				audioData.push_back(buffer[end - 1]);
-				for (std::size_t j = i; j < end - 1; ++j)
-					audioData.push_back(buffer[j]);
-			}
-			else if (end - i == 1)
-			{
-				audioData.push_back(buffer[i]);
-			}
-		}
+		kernel::ByteCascadeSwap(blockSize, util::Alignment(wavm, align)).apply(audioData, 0);
 
 		util::ReturnAudioData(audioData, wavm);
 	}
@@ -430,32 +962,75 @@ namespace algo
 	{}
 
 	// uniformly drop bytes from the audio data
-	inline void Dropout(const std::string& inputFile, std::vector<std::uint8_t>& audioData, const WavMetadata* wavm, double dropPercentage = 0.5)
+	inline void Dropout(std::span<const std::uint8_t> input, std::vector<std::uint8_t>& audioData, const WavMetadata*, double dropPercentage = 0.5, std::uint64_t seed = 0)
 	{
-		audioData = util::GetAudioData(inputFile, "Dropout", wavm);
-
 		if (dropPercentage <= 0.0 || dropPercentage >= 1.0)
 		{
 			std::cerr << "(algo::Dropout) Error: dropPercentage must be between 0 and 1" << std::endl;
 			throw std::runtime_error("(algo::Dropout) Invalid dropPercentage value");
 		}
 
-		std::random_device rd;
-		std::mt19937 gen(rd());
-		std::uniform_real_distribution<> prob(0.0, 1.0);
+		// Each segment draws from its own Philox stream, so the kept bytes only depend on the
+		// seed. The stream ids sit above the ones ByteBitFlip uses for the same seed.
+		constexpr std::size_t SEGMENT = 64 * 1024;
+		constexpr std::uint64_t DROPOUT_STREAMS = std::uint64_t{ 1 } << 48;
 
-		std::vector<std::uint8_t> modifiedData;
-		modifiedData.reserve(audioData.size());
+		// a byte is kept when its 32-bit draw is at or above the threshold
+		const std::uint32_t threshold = static_cast<std::uint32_t>(std::min(dropPercentage * 4294967296.0, 4294967295.0));
 
-		for (const auto& byte : audioData)
+		std::size_t segments = (input.size() + SEGMENT - 1) / SEGMENT;
+		std::vector<std::uint8_t> keepMask((input.size() + 7) / 8);
+		std::vector<std::size_t> keptBytes(segments);
+
+		// Build the keep mask and count the survivors of each segment
+		par::ParallelFor(segments, [&](std::size_t begin, std::size_t end)
 		{
-			if (prob(gen) >= dropPercentage)
+			for (std::size_t segment = begin; segment < end; ++segment)
 			{
-				modifiedData.push_back(byte);
+				rng::PhiloxStream stream{ seed, DROPOUT_STREAMS + segment };
+				std::size_t start = segment * SEGMENT;
+				std::size_t stop = std::min(start + SEGMENT, input.size());
+				std::size_t kept = 0;
+				for (std::size_t i = start; i < stop; i += 8)
+				{
+					std::uint8_t bits = 0;
+					for (std::size_t j = 0; j < 8 && i + j < stop; ++j)
+					{
+						bits |= static_cast<std::uint8_t>((stream.Next() >= threshold ? 1 : 0) << j);
+					}
+					keepMask[i / 8] = bits;
+					kept += std::popcount(bits);
+				}
+				keptBytes[segment] = kept;
 			}
+		}, 4);
+
+		// Exclusive prefix sum gives every segment its final output offset
+		std::size_t total = 0;
+		for (auto& kept : keptBytes)
+		{
+			std::size_t count = kept;
+			kept = total;
+			total += count;
 		}
 
-		audioData = std::move(modifiedData);
+		// Compact each segment straight into its place in the output
+		audioData.resize(total);
+		par::ParallelFor(segments, [&](std::size_t begin, std::size_t end)
+		{
+			for (std::size_t segment = begin; segment < end; ++segment)
+			{
+				std::size_t start = segment * SEGMENT;
+				std::size_t size = std::min(SEGMENT, input.size() - start);
+				simd::CompactBytes(input.data() + start, keepMask.data() + start / 8, size, audioData.data() + keptBytes[segment]);
+			}
+		}, 4);
+	}
+
+	inline void Dropout(const std::string& inputFile, std::vector<std::uint8_t>& audioData, const WavMetadata* wavm, double dropPercentage = 0.5, std::uint64_t seed = 0)
+	{
+		util::AudioSource source = util::GetAudioSource(inputFile, "Dropout", wavm);
+		Dropout(source.Span(), audioData, wavm, dropPercentage, seed);
 
 		util::ReturnAudioData(audioData, wavm);
 	}
@@ -465,17 +1040,101 @@ namespace algo
 	{
 		audioData = util::GetAudioData(inputFile, "Stutter", wavm);
 
-		if (n == 0)
+		kernel::Stutter(n).apply(audioData, 0);
+
+		util::ReturnAudioData(audioData, wavm);
+	}
+
+	// One step of RunPipeline. Block-local steps set kernel and work on the buffer in place;
+	// the others set transform, which reads its input and fills output.
+	struct Stage
+	{
+		std::string name;
+		kernel::BlockKernel kernel;
+		std::function<void(std::span<const std::uint8_t> input, std::vector<std::uint8_t>& output)> transform;
+	};
+
+	// Run the stages one after another on the input held in memory. In-place stages change the
+	// buffer, out-of-place stages write into a second buffer that then trades places with the
+	// first, so no stage copies the data it hands on. Runs of in-place stages are fused into one
+	// cache-tiled pass (kernel::Fuse). With mp3 conversion the input is encoded once before the
+	// first stage and decoded once after the last.
+	inline void RunPipeline(const std::string& inputFile, const std::vector<Stage>& stages, std::vector<std::uint8_t>& audioData, const WavMetadata* wavm)
+	{
+		*report << "Input: " << inputFile << std::endl;
+
+		if (stages.empty())
 		{
-			std::cerr << "(algo::Stutter) Error: n must be greater than 0" << std::endl;
-			throw std::runtime_error("(algo::Stutter) Invalid n value");
+			std::cerr << "(algo::RunPipeline) Error: the pipeline has no stages" << std::endl;
+			throw std::runtime_error("(algo::RunPipeline) No stages");
 		}
 
-		for (std::size_t i = n - 1; i < audioData.size(); i += n)
+		// an in-place first stage needs a writable copy anyway, so the input is read straight
+		// into the buffer; otherwise the first stage reads the mapping
+		util::AudioSource source;
+		std::span<const std::uint8_t> input;
+		if (stages.front().kernel.apply)
 		{
-			audioData[i] = 0;
+			audioData = util::GetAudioData(inputFile, "RunPipeline", wavm);
+			input = audioData;
+		}
+		else
+		{
+			source = util::GetAudioSource(inputFile, "RunPipeline", wavm);
+			input = source.Span();
+		}
+
+		std::vector<std::uint8_t> scratch;
+		for (std::size_t i = 0; i < stages.size();)
+		{
+			const Stage& stage = stages[i];
+
+			if (!stage.kernel.apply)
+			{
+				*report << "Stage " << i + 1 << ": " << stage.name << std::endl;
+				stats::Scope scope{ stage.name.c_str() };
+				scope.BytesIn(input.size());
+				stage.transform(input, scratch);
+				scope.BytesOut(scratch.size());
+				audioData.swap(scratch);
+				input = audioData;
+				++i;
+				continue;
+			}
+
+			// consecutive block-local stages run as one tiled pass, as long as their blocks line up
+			// within a tile that still fits in cache
+			std::vector<kernel::BlockKernel> group{ stage.kernel };
+			std::string names = stage.name;
+			std::size_t granularity = stage.kernel.granularity;
+			std::size_t next = i + 1;
+			for (; next < stages.size() && stages[next].kernel.apply; ++next)
+			{
+				std::size_t fused = kernel::FusedGranularity(granularity, stages[next].kernel.granularity);
+				if (fused == 0) break;
+
+				granularity = fused;
+				group.push_back(stages[next].kernel);
+				names += "+" + stages[next].name;
+			}
+
+			stats::Scope scope{ group.size() == 1 ? stage.name.c_str() : names.c_str() };
+			scope.BytesIn(audioData.size());
+			scope.BytesOut(audioData.size());
+			if (group.size() == 1)
+			{
+				*report << "Stage " << i + 1 << ": " << stage.name << std::endl;
+				stage.kernel.apply(audioData, 0);
+			}
+			else
+			{
+				*report << "Stages " << i + 1 << "-" << next << ": " << names << " (fused)" << std::endl;
+				kernel::Fuse(std::move(group)).apply(audioData, 0);
+			}
+			input = audioData;
+			i = next;
 		}
 
 		util::ReturnAudioData(audioData, wavm);
 	}
-}
\ No newline at end of file
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <lame.h>
+#include <mpg123.h>
+
+#include "WaveFile.h"
+
+namespace codec
+{
+	// Process-wide library setup (mpg123_init), done once however many threads ask for it.
+	// Pooled handles are freed and mpg123_exit runs when the process exits.
+	void Init();
+
+	// A LAME encoder for one stream, closed when the object goes away. With independentFrames
+	// the bit reservoir and the VBR tag frame are turned off, so every frame decodes on its own.
+	// Encoders are not pooled: once a stream is flushed, the delay and padding bookkeeping that
+	// lame_init_params set up is spent, and lame_init_bitstream only continues a gapless stream,
+	// so a reused encoder would not produce the same output as a fresh one.
+	class Encoder
+	{
+	public:
+		Encoder(wf::WaveFile::SampleRate sampleRate, wf::WaveFile::Channels channels, bool independentFrames);
+		~Encoder();
+
+		Encoder(const Encoder&) = delete;
+		Encoder& operator=(const Encoder&) = delete;
+		Encoder(Encoder&& other) noexcept;
+		Encoder& operator=(Encoder&& other) noexcept;
+
+		lame_t Get() const { return lame; }
+
+	private:
+		lame_t lame = nullptr;
+	};
+
+	// An mpg123 handle opened for feeding with a fixed output format. Handles come from a
+	// process-wide pool and go back to it when the object goes away: closing and reopening
+	// the feed resets the decoder completely, and the format setup is kept, so repeated
+	// decodes only pay for mpg123_new once per thread and format.
+	class Decoder
+	{
+	public:
+		Decoder(wf::WaveFile::SampleRate sampleRate, wf::WaveFile::Channels channels, int encoding, bool verbose);
+		~Decoder();
+
+		Decoder(const Decoder&) = delete;
+		Decoder& operator=(const Decoder&) = delete;
+		Decoder(Decoder&& other) noexcept;
+		Decoder& operator=(Decoder&& other) noexcept;
+
+		mpg123_handle* Get() const { return mh; }
+
+	private:
+		void Release();
+
+		mpg123_handle* mh = nullptr;
+		long rate = 0;
+		int channels = 0;
+		int encoding = 0;
+		bool verbose = false;
+	};
+}
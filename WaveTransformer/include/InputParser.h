@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -13,6 +14,8 @@ public:
         for (int i = 1; i < argc; ++i)
             this->tokens.push_back(std::string(argv[i]));
     }
+    // tokens as they would follow the program name, e.g. one line of a batch manifest
+    explicit InputParser(std::vector<std::string> tokens) : tokens(std::move(tokens)) {}
     /// @author iain
     const std::string& getCmdOption(const std::string& option) const {
         std::vector<std::string>::const_iterator itr;
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "WaveFile.h"
+#include "MappedFile.h"
+#include "Options.h"
+
+namespace job
+{
+	// One run of an operation with all of its settings, parsed from the command line or from a
+	// line of a batch manifest. Nothing here refers back to argv, so jobs can be run side by side.
+	struct Job
+	{
+		std::string name; // operation as written, used for tagging
+		opt::operation::OPERATIONS operation = opt::operation::OP_REINTERPRET;
+		std::vector<std::string> inputs; // arguments after the operation, up to the first option
+
+		wf::WaveFile::SampleRate sampleRate = static_cast<wf::WaveFile::SampleRate>(opt::sample_rate::DEFAULT);
+		wf::WaveFile::BitsPerSample bitDepth = static_cast<wf::WaveFile::BitsPerSample>(opt::bit_depth::DEFAULT);
+		wf::WaveFile::Channels channels = static_cast<wf::WaveFile::Channels>(opt::channels::DEFAULT);
+		wf::WaveFile::AudioFormat format = static_cast<wf::WaveFile::AudioFormat>(opt::format::DEFAULT);
+
+		std::string outputFile = opt::output::DEFAULT; // tagged when tag is set
+		std::string outputNoTag = opt::output::DEFAULT;
+		bool tag = false;
+
+		std::size_t blockSize = opt::block_size::DEFAULT;
+		double probability = opt::probability::DEFAULT;
+		std::size_t min = opt::block_range::DEFAULT_MIN;
+		std::size_t max = opt::block_range::DEFAULT_MAX;
+		bool align = opt::byte_align::DEFAULT;
+		bool sampleDomain = opt::sample_domain::DEFAULT;
+		int nthbyte = opt::nth_byte::DEFAULT;
+		std::size_t unit = opt::unit::DEFAULT;
+		std::uint64_t seed = 0; // drawn from random_device when not given
+		io::Range range; // byte range of every input, from offset and length
+		bool wavInput = opt::wav_input::DEFAULT;
+
+		bool convertMp3 = opt::convert_mp3::DEFAULT;
+		bool verbose = opt::verbose_mpg123::DEFAULT;
+		bool parallelMp3 = opt::parallel_mp3::DEFAULT;
+		bool stats = opt::stats::DEFAULT;
+		std::string statsFile; // JSON output, empty for a table on stdout
+
+		std::vector<Job> stages; // pipe only, in order
+	};
+
+	// Parse tokens as they follow the program name. Prints the problem and throws on an unknown
+	// operation or a malformed option value. For pipe, every stage is parsed into its own job
+	// from the stage's parameters followed by the options of the whole command.
+	Job Parse(const std::vector<std::string>& tokens);
+
+	// Run the job on the calling thread. Returns the process exit code (0 on success).
+	// With stats on, the stages of the job are timed and reported once it is done.
+	int Run(const Job& job);
+
+	// Split a manifest line into tokens at whitespace; double quotes group a token with spaces.
+	std::vector<std::string> Tokenize(const std::string& line);
+
+	// Run every job of the manifest on up to workers threads (0 for one per core). A job waits
+	// until the size of its inputs fits in the shared ioBudget (in MiB) before it starts.
+	// Prints one status line per job as it finishes and returns 1 if any of them failed.
+	int RunBatch(const std::string& manifest, std::size_t workers, std::size_t ioBudget);
+}
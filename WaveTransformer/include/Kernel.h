@@ -0,0 +1,271 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <functional>
+#include <algorithm>
+#include <stdexcept>
+#include <iostream>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <vector>
+#include <cstring>
+
+#include "Parallel.h"
+#include "Random.h"
+#include "Simd.h"
+
+namespace algo
+{
+	namespace kernel
+	{
+		// A transform that only looks at the current byte or the current block, so it can be
+		// applied to a window of the data at a time. Windows passed to apply are a multiple of
+		// granularity long (except the last one) and start at offset in the whole stream.
+		struct BlockKernel
+		{
+			std::size_t granularity = 1;
+			std::function<void(std::span<std::uint8_t> window, std::uint64_t offset)> apply;
+		};
+
+		// bytes a pool task gets at least when a kernel splits its blocks between threads,
+		// below that handing the work out costs more than it saves
+		constexpr std::size_t PARALLEL_MIN_BYTES = 1024 * 1024;
+
+		// The block engine: calls fn(part, start) on parts of the window made of whole blocks, start
+		// being the offset of the part in the window. Parts are contiguous and handed to the pool in
+		// runs, so a core walks neighbouring memory and idle cores steal what is left at the end.
+		template<typename Fn>
+		void ForBlocks(std::span<std::uint8_t> window, std::size_t blockSize, Fn&& fn)
+		{
+			std::size_t blocks = (window.size() + blockSize - 1) / blockSize;
+			par::ParallelFor(blocks, [&](std::size_t begin, std::size_t end)
+			{
+				std::size_t from = begin * blockSize;
+				std::size_t to = std::min(end * blockSize, window.size());
+				fn(window.subspan(from, to - from), from);
+			}, std::max<std::size_t>(1, PARALLEL_MIN_BYTES / blockSize));
+		}
+
+		// blockSize rounded up to a multiple of alignment, the bytes per sample with --bytealign
+		inline std::size_t AlignBlockSize(std::size_t blockSize, std::size_t alignment)
+		{
+			if (alignment > 1)
+			{
+				blockSize = (blockSize + alignment - 1) / alignment * alignment;
+			}
+			return blockSize;
+		}
+
+		// A kernel made from an in-place operation on blocks: perBlocks(blocks, blockSize, first)
+		// gets a run of consecutive blocks (the last one of the stream may be short), first being
+		// the number of the first of them in the whole stream. The engine checks and aligns the
+		// block size and spreads the runs over the pool, so a new block operation only has to say
+		// what it does to its blocks.
+		template<typename PerBlocks>
+		BlockKernel Blocks(const char* algoName, std::size_t blockSize, std::size_t alignment, PerBlocks perBlocks)
+		{
+			if (blockSize == 0)
+			{
+				std::cerr << "(algo::" << algoName << ") Error: blockSize must be greater than 0" << std::endl;
+				throw std::runtime_error(std::string("(algo::") + algoName + ") Invalid blockSize value");
+			}
+			blockSize = AlignBlockSize(blockSize, alignment);
+
+			return { blockSize, [blockSize, perBlocks](std::span<std::uint8_t> window, std::uint64_t offset)
+			{
+				// windows start on a block boundary of the stream
+				ForBlocks(window, blockSize, [&](std::span<std::uint8_t> part, std::size_t start)
+				{
+					perBlocks(part, blockSize, (offset + start) / blockSize);
+				});
+			} };
+		}
+
+		// a run of bytes of the input of an out-of-place block transform
+		struct Block
+		{
+			std::size_t offset;
+			std::size_t length;
+		};
+
+		// Copy count blocks of input back to back into output, blockAt(i) giving the ith one. Parts of
+		// the block table find their output position from a prefix sum of the lengths before them
+		// and are copied in parallel.
+		template<typename BlockAt>
+		void GatherBlocks(std::span<const std::uint8_t> input, std::uint8_t* output, std::size_t count, BlockAt&& blockAt)
+		{
+			std::size_t parts = std::min({ count, par::ThreadCount() * par::CHUNKS_PER_THREAD, std::max<std::size_t>(1, input.size() / PARALLEL_MIN_BYTES) });
+			if (parts == 0) return;
+
+			auto partRange = [&](std::size_t part)
+			{
+				return std::pair<std::size_t, std::size_t>{ count * part / parts, count * (part + 1) / parts };
+			};
+
+			std::vector<std::size_t> partBytes(parts);
+			par::ParallelFor(parts, [&](std::size_t begin, std::size_t end)
+			{
+				for (std::size_t part = begin; part < end; ++part)
+				{
+					auto [from, to] = partRange(part);
+					std::size_t bytes = 0;
+					for (std::size_t i = from; i < to; ++i) bytes += blockAt(i).length;
+					partBytes[part] = bytes;
+				}
+			});
+
+			std::size_t position = 0;
+			for (auto& bytes : partBytes)
+			{
+				std::size_t size = bytes;
+				bytes = position;
+				position += size;
+			}
+
+			par::ParallelFor(parts, [&](std::size_t begin, std::size_t end)
+			{
+				for (std::size_t part = begin; part < end; ++part)
+				{
+					auto [from, to] = partRange(part);
+					std::uint8_t* out = output + partBytes[part];
+					for (std::size_t i = from; i < to; ++i)
+					{
+						Block block = blockAt(i);
+						std::memcpy(out, input.data() + block.offset, block.length);
+						out += block.length;
+					}
+				}
+			});
+		}
+
+		// set every nth byte to zero
+		inline BlockKernel Stutter(std::size_t n)
+		{
+			if (n == 0)
+			{
+				std::cerr << "(algo::Stutter) Error: n must be greater than 0" << std::endl;
+				throw std::runtime_error("(algo::Stutter) Invalid n value");
+			}
+
+			// one byte blocks, so first is the position of the run in the stream
+			return Blocks("Stutter", 1, 1, [n](std::span<std::uint8_t> bytes, std::size_t, std::uint64_t first)
+			{
+				// first index in the run with (first + i) % n == n - 1
+				std::size_t silenced = static_cast<std::size_t>((n - 1 - first % n) % n);
+				simd::SilenceFrames(bytes.data(), bytes.size(), 1, n, silenced, 0);
+			});
+		}
+
+		// bytes per independent random stream in ByteBitFlip, fixed so the output only depends on the seed
+		constexpr std::size_t BIT_FLIP_SEGMENT = 64 * 1024;
+
+		// flip one random bit in each byte with the given probability. The gaps between flipped
+		// bytes are geometric, so only the flipped bytes cost a random draw. Each segment has
+		// its own Philox stream, which lets segments run on any thread in any order.
+		inline BlockKernel ByteBitFlip(double flipProbability, std::uint64_t seed)
+		{
+			return { BIT_FLIP_SEGMENT, [flipProbability, seed](std::span<std::uint8_t> window, std::uint64_t offset)
+			{
+				if (flipProbability <= 0.0) return;
+
+				// log(1 - p), every byte flips when p >= 1
+				double logKeep = flipProbability < 1.0 ? std::log1p(-flipProbability) : -std::numeric_limits<double>::infinity();
+				std::size_t segments = (window.size() + BIT_FLIP_SEGMENT - 1) / BIT_FLIP_SEGMENT;
+
+				par::ParallelFor(segments, [&](std::size_t begin, std::size_t end)
+				{
+					for (std::size_t segment = begin; segment < end; ++segment)
+					{
+						std::size_t start = segment * BIT_FLIP_SEGMENT;
+						std::size_t size = std::min(BIT_FLIP_SEGMENT, window.size() - start);
+						std::uint8_t* bytes = window.data() + start;
+
+						rng::PhiloxStream stream{ seed, offset / BIT_FLIP_SEGMENT + segment };
+
+						// number of untouched bytes before the next flip
+						auto gap = [&]()
+						{
+							double skip = std::floor(std::log(stream.NextUnit()) / logKeep);
+							return skip < static_cast<double>(size) ? static_cast<std::size_t>(skip) : size;
+						};
+
+						for (std::size_t i = gap(); i < size; i += 1 + gap())
+						{
+							bytes[i] ^= static_cast<std::uint8_t>(1 << (stream.Next() & 7));
+						}
+					}
+				}, 16);
+			} };
+		}
+
+		// reverse the order of bytes within each block
+		inline BlockKernel ByteMirror(std::size_t blockSize, std::size_t alignment = 1)
+		{
+			return Blocks("ByteMirror", blockSize, alignment, [](std::span<std::uint8_t> blocks, std::size_t size, std::uint64_t)
+			{
+				simd::MirrorBlocks(blocks.data(), blocks.size(), size);
+			});
+		}
+
+		// shift each block right by one byte
+		inline BlockKernel ByteCascadeSwap(std::size_t blockSize, std::size_t alignment = 1)
+		{
+			return Blocks("ByteCascadeSwap", blockSize, alignment, [](std::span<std::uint8_t> blocks, std::size_t size, std::uint64_t)
+			{
+				simd::RotateBlocksRight(blocks.data(), blocks.size(), size);
+			});
+		}
+
+		// bytes per tile of a fused pass, small enough to stay in a core's L2 from one kernel to the next
+		constexpr std::size_t FUSE_TILE = 512 * 1024;
+		// kernels are not fused once their common granularity passes this, the tiles would not stay cached
+		constexpr std::size_t FUSE_MAX_GRANULARITY = 4 * FUSE_TILE;
+
+		// smallest length that is a multiple of both granularities, 0 when it is over FUSE_MAX_GRANULARITY
+		inline std::size_t FusedGranularity(std::size_t a, std::size_t b)
+		{
+			std::size_t step = a / std::gcd(a, b);
+			if (b > FUSE_MAX_GRANULARITY || step > FUSE_MAX_GRANULARITY / b) return 0;
+			return step * b;
+		}
+
+		// One pass that runs every kernel, in order, on a tile before moving to the next tile, so the
+		// data goes through the cache once instead of once per kernel. Tiles are a multiple of every
+		// kernel's granularity, which gives each kernel the same blocks at the same offsets as a pass
+		// of its own, so the output is identical. Tiles are independent and run in parallel.
+		inline BlockKernel Fuse(std::vector<BlockKernel> kernels)
+		{
+			std::size_t granularity = 1;
+			for (const BlockKernel& k : kernels)
+			{
+				granularity = FusedGranularity(granularity, k.granularity);
+				if (granularity == 0)
+				{
+					std::cerr << "(algo::kernel::Fuse) Error: kernel blocks are too large to fuse" << std::endl;
+					throw std::runtime_error("(algo::kernel::Fuse) Granularity too large");
+				}
+			}
+
+			std::size_t tile = std::max<std::size_t>(1, FUSE_TILE / granularity) * granularity;
+
+			return { granularity, [kernels = std::move(kernels), tile](std::span<std::uint8_t> window, std::uint64_t offset)
+			{
+				std::size_t tiles = (window.size() + tile - 1) / tile;
+				par::ParallelFor(tiles, [&](std::size_t begin, std::size_t end)
+				{
+					for (std::size_t t = begin; t < end; ++t)
+					{
+						std::size_t start = t * tile;
+						std::span<std::uint8_t> part = window.subspan(start, std::min(tile, window.size() - start));
+						for (const BlockKernel& k : kernels)
+						{
+							k.apply(part, offset + start);
+						}
+					}
+				});
+			} };
+		}
+	}
+}
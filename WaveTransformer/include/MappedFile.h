@@ -0,0 +1,98 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <vector>
+#include <span>
+
+namespace io
+{
+	// Read-only memory mapping of a whole file.
+	// The mapped bytes stay valid for the lifetime of the object.
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		explicit MappedFile(const std::string& path);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+
+		void Open(const std::string& path);
+		void Close();
+
+		bool IsOpen() const;
+		const std::uint8_t* Data() const;
+		std::size_t Size() const;
+		std::span<const std::uint8_t> Span() const;
+
+	private:
+		const std::uint8_t* data = nullptr;
+		std::size_t size = 0;
+		bool open = false;
+#ifdef _WIN32
+		void* fileHandle = nullptr;
+		void* mappingHandle = nullptr;
+#else
+		int fd = -1;
+#endif
+	};
+
+	// File opened for positioned reads (pread, ReadFile with an OVERLAPPED offset on Windows).
+	// There is no shared file position, so any thread can read any range at any time.
+	class InputFile
+	{
+	public:
+		InputFile() = default;
+		explicit InputFile(const std::string& path);
+		~InputFile();
+
+		InputFile(const InputFile&) = delete;
+		InputFile& operator=(const InputFile&) = delete;
+		InputFile(InputFile&& other) noexcept;
+		InputFile& operator=(InputFile&& other) noexcept;
+
+		void Open(const std::string& path);
+		void Close();
+
+		bool IsOpen() const;
+		std::uint64_t Size() const;
+		// fill all of out from offset on, throws when the file ends first
+		void ReadAt(std::uint64_t offset, std::span<std::uint8_t> out) const;
+		// Copy length bytes from offset on into the existing file at path, starting at position at.
+		// On Linux the bytes never enter the process: copy_file_range (a reflink on filesystems
+		// that share extents), then sendfile; elsewhere they go through a buffer of positioned reads.
+		void CopyTo(std::uint64_t offset, std::uint64_t length, const std::string& path, std::uint64_t at) const;
+
+	private:
+		std::string path;
+		std::uint64_t size = 0;
+#ifdef _WIN32
+		void* fileHandle = nullptr;
+#else
+		int fd = -1;
+#endif
+	};
+
+	// Byte range of an input file, length ToEnd meaning up to the end of the file.
+	struct Range
+	{
+		static constexpr std::uint64_t ToEnd = ~std::uint64_t{ 0 };
+
+		std::uint64_t offset = 0;
+		std::uint64_t length = ToEnd;
+
+		bool Whole() const { return offset == 0 && length == ToEnd; }
+		// bytes of a file of fileSize the range covers, throws when offset is past the end
+		std::uint64_t Clamp(std::uint64_t fileSize) const;
+	};
+
+	// Read a whole file into a single pre-sized buffer with one bulk read.
+	std::vector<std::uint8_t> ReadAll(const std::string& path);
+
+	// Read only the bytes of range with positioned reads, the rest of the file is never touched.
+	std::vector<std::uint8_t> ReadRange(const std::string& path, const Range& range);
+}
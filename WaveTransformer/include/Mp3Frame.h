@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+namespace mp3
+{
+	// The parts of an MPEG audio layer III frame header needed to walk a stream frame by frame
+	struct FrameHeader
+	{
+		std::size_t length = 0; // whole frame in bytes, header included
+		std::size_t samples = 0; // per channel
+		int sampleRate = 0;
+		int channels = 0;
+		bool mpeg1 = false;
+		bool crc = false; // a 16-bit crc follows the header
+		std::size_t sideInfo = 0; // bytes of side information after the header (and crc)
+	};
+
+	// Parse the 4-byte header at data. Returns false for anything that is not a layer III
+	// frame with a known bitrate (free format streams have no length in the header).
+	inline bool ParseFrameHeader(const std::uint8_t* data, std::size_t available, FrameHeader& header)
+	{
+		if (available < 4) return false;
+		if (data[0] != 0xFF || (data[1] & 0xE0) != 0xE0) return false;
+
+		// 0: MPEG 2.5, 2: MPEG 2, 3: MPEG 1
+		int version = (data[1] >> 3) & 0x03;
+		int layer = (data[1] >> 1) & 0x03;
+		int bitrateIndex = (data[2] >> 4) & 0x0F;
+		int rateIndex = (data[2] >> 2) & 0x03;
+		int padding = (data[2] >> 1) & 0x01;
+		int mode = (data[3] >> 6) & 0x03;
+
+		if (version == 1 || layer != 1 || bitrateIndex == 0 || bitrateIndex == 15 || rateIndex == 3) return false;
+
+		static constexpr int BITRATES_V1[15] = { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 };
+		static constexpr int BITRATES_V2[15] = { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 };
+		static constexpr int RATES[3] = { 44100, 48000, 32000 };
+
+		bool mpeg1 = version == 3;
+		int bitrate = (mpeg1 ? BITRATES_V1 : BITRATES_V2)[bitrateIndex] * 1000;
+		int sampleRate = RATES[rateIndex] >> (mpeg1 ? 0 : (version == 2 ? 1 : 2));
+
+		header.samples = mpeg1 ? 1152 : 576;
+		header.length = static_cast<std::size_t>((mpeg1 ? 144 : 72) * bitrate / sampleRate + padding);
+		header.sampleRate = sampleRate;
+		header.channels = mode == 3 ? 1 : 2;
+		header.mpeg1 = mpeg1;
+		header.crc = (data[1] & 0x01) == 0;
+		header.sideInfo = mpeg1 ? (header.channels == 1 ? 17 : 32) : (header.channels == 1 ? 9 : 17);
+
+		// too short to hold its own side information
+		return header.length >= 4 + (header.crc ? 2 : 0) + header.sideInfo;
+	}
+
+	// offset of the side information (and of a Xing/Info tag) from the start of the frame
+	inline std::size_t SideInfoOffset(const FrameHeader& header)
+	{
+		return 4 + (header.crc ? 2 : 0);
+	}
+
+	// bytes of main data the frame carries itself, available to later frames through the bit reservoir
+	inline std::size_t MainDataSize(const FrameHeader& header)
+	{
+		return header.length - SideInfoOffset(header) - header.sideInfo;
+	}
+
+	// how far (in bytes of main data) the frame's own main data starts back in earlier frames
+	inline std::size_t MainDataBegin(const std::uint8_t* frame, const FrameHeader& header)
+	{
+		const std::uint8_t* side = frame + SideInfoOffset(header);
+		if (header.mpeg1)
+			return (static_cast<std::size_t>(side[0]) << 1) | (side[1] >> 7);
+		return side[0];
+	}
+
+	// the first frame of a LAME/Xing encoded stream holds a Xing, Info or VBRI tag instead of audio
+	inline bool IsInfoFrame(const std::uint8_t* frame, const FrameHeader& header)
+	{
+		std::size_t xing = SideInfoOffset(header) + header.sideInfo;
+		if (header.length >= xing + 4 && (std::memcmp(frame + xing, "Xing", 4) == 0 || std::memcmp(frame + xing, "Info", 4) == 0))
+			return true;
+		return header.length >= 36 + 4 && std::memcmp(frame + 36, "VBRI", 4) == 0;
+	}
+
+	// size of an ID3v2 tag at the start of data, 0 if there is none
+	inline std::size_t Id3v2Size(std::span<const std::uint8_t> data)
+	{
+		if (data.size() < 10 || std::memcmp(data.data(), "ID3", 3) != 0) return 0;
+
+		// syncsafe integer, 7 bits per byte
+		std::size_t size = (static_cast<std::size_t>(data[6] & 0x7F) << 21) | (static_cast<std::size_t>(data[7] & 0x7F) << 14) |
+			(static_cast<std::size_t>(data[8] & 0x7F) << 7) | static_cast<std::size_t>(data[9] & 0x7F);
+		size += 10;
+		if (data[5] & 0x10) size += 10; // footer
+		return size <= data.size() ? size : 0;
+	}
+
+	// Offsets of consecutive frames from the start of data. Stops at the first byte that does not
+	// start a frame (trailing tags, garbage); the returned size tells how many frames were found.
+	inline std::vector<std::size_t> FrameOffsets(std::span<const std::uint8_t> data)
+	{
+		std::vector<std::size_t> offsets;
+		FrameHeader header;
+		std::size_t pos = 0;
+		while (ParseFrameHeader(data.data() + pos, data.size() - pos, header) && pos + header.length <= data.size())
+		{
+			offsets.push_back(pos);
+			pos += header.length;
+		}
+		return offsets;
+	}
+
+	// Frames of a whole stream: skips a leading ID3v2 tag and walks frames until the first byte
+	// that does not start one. end is one past the last frame.
+	struct FrameIndex
+	{
+		std::vector<std::size_t> offsets;
+		std::size_t end = 0;
+		FrameHeader first;
+	};
+
+	inline FrameIndex IndexFrames(std::span<const std::uint8_t> data)
+	{
+		FrameIndex index;
+		std::size_t start = Id3v2Size(data);
+		index.offsets = FrameOffsets(data.subspan(start));
+		index.end = start;
+		if (index.offsets.empty()) return index;
+
+		for (std::size_t& offset : index.offsets)
+		{
+			offset += start;
+		}
+
+		FrameHeader last;
+		ParseFrameHeader(data.data() + index.offsets.back(), data.size() - index.offsets.back(), last);
+		ParseFrameHeader(data.data() + index.offsets.front(), data.size() - index.offsets.front(), index.first);
+		index.end = index.offsets.back() + last.length;
+		return index;
+	}
+}
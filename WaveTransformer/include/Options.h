@@ -129,6 +129,53 @@ namespace opt
 		constexpr std::size_t DEFAULT = 1;
 	}
 
+	constexpr const char* SAMPLE_DOMAIN_SHORT = "-d";
+	constexpr const char* SAMPLE_DOMAIN_LONG = "--sampledomain";
+	namespace sample_domain
+	{
+		constexpr const char* DESCRIPTION = "Work on whole samples instead of bytes (bymir, caswp, stutr, bitfl): blocks and n count frames of one sample per channel, stutr silences frames and bitfl flips a bit within samples.";
+		constexpr bool DEFAULT = false;
+	} // namespace sample_domain
+
+	constexpr const char* UNIT_SHORT = "-u";
+	constexpr const char* UNIT_LONG = "--unit";
+	namespace unit
+	{
+		constexpr const char* DESCRIPTION = "Bytes taken from each input in turn when interlacing, or 'sample' for bit depth/8 (one input per channel).";
+		constexpr const char* UNIT_SAMPLE = "sample";
+		constexpr std::size_t DEFAULT = 1;
+	} // namespace unit
+
+	constexpr const char* SEED_SHORT = "-e";
+	constexpr const char* SEED_LONG = "--seed";
+	namespace seed
+	{
+		constexpr const char* DESCRIPTION = "Seed for random operations (bitfl, dropt), the same seed always gives the same output.";
+	} // namespace seed
+
+	constexpr const char* OFFSET_SHORT = "-O";
+	constexpr const char* OFFSET_LONG = "--offset";
+	namespace offset
+	{
+		constexpr const char* DESCRIPTION = "Byte offset into every input file to start reading at; bytes before it are never read.";
+		constexpr std::uint64_t DEFAULT = 0;
+	} // namespace offset
+
+	constexpr const char* LENGTH_SHORT = "-L";
+	constexpr const char* LENGTH_LONG = "--length";
+	namespace length
+	{
+		constexpr const char* DESCRIPTION = "Number of bytes of every input file to read from the offset on, cut at the end of the file.";
+	} // namespace length
+
+	constexpr const char* WAV_INPUT_SHORT = "-w";
+	constexpr const char* WAV_INPUT_LONG = "--wavinput";
+	namespace wav_input
+	{
+		constexpr const char* DESCRIPTION = "Inputs are wave files: operate on the samples of their data chunk only and leave the headers out; offset and length count from the first sample. Rate, bit depth, channels and format come from the first input unless given.";
+		constexpr bool DEFAULT = false;
+	} // namespace wav_input
+
 	constexpr const char* CONVERT_MP3_SHORT = "-m";
 	constexpr const char* CONVERT_MP3_LONG = "--convertmp3";
 	namespace convert_mp3
@@ -137,6 +184,14 @@ namespace opt
 		constexpr bool DEFAULT = false;
 	} // namespace convert_mp3
 
+	constexpr const char* PARALLEL_MP3_SHORT = "-P";
+	constexpr const char* PARALLEL_MP3_LONG = "--parallelmp3";
+	namespace parallel_mp3
+	{
+		constexpr const char* DESCRIPTION = "Encode mp3 in segments on all cores (no bit reservoir, no VBR tag). Frames at the seams can differ slightly from a serial encode.";
+		constexpr bool DEFAULT = false;
+	} // namespace parallel_mp3
+
 	constexpr const char* VERBOSE_MPG123_SHORT = "-v";
 	constexpr const char* VERBOSE_MPG123_LONG = "--verbosempg123";
 	namespace verbose_mpg123
@@ -145,6 +200,38 @@ namespace opt
 		constexpr bool DEFAULT = false;
 	} // namespace verbose_mpg123
 
+	constexpr const char* STATS_SHORT = "-S";
+	constexpr const char* STATS_LONG = "--stats";
+	namespace stats
+	{
+		constexpr const char* DESCRIPTION = "Time each stage (read, mp3 encode, transform, mp3 decode, write): wall and cpu time, bytes in and out, peak memory. Prints a table, or writes JSON when followed by a file name.";
+		constexpr bool DEFAULT = false;
+	} // namespace stats
+
+	constexpr const char* JOBS_SHORT = "-j";
+	constexpr const char* JOBS_LONG = "--jobs";
+	namespace jobs
+	{
+		constexpr const char* DESCRIPTION = "Number of manifest jobs run at the same time (batch), 0 for one per core.";
+		constexpr std::size_t DEFAULT = 0;
+	} // namespace jobs
+
+	constexpr const char* THREADS_SHORT = "-T";
+	constexpr const char* THREADS_LONG = "--threads";
+	namespace threads
+	{
+		constexpr const char* DESCRIPTION = "Number of threads block operations are spread over, 0 for one per core; set for the whole process, manifest lines cannot change it.";
+		constexpr std::size_t DEFAULT = 0;
+	} // namespace threads
+
+	constexpr const char* IO_BUDGET_SHORT = "-i";
+	constexpr const char* IO_BUDGET_LONG = "--iobudget";
+	namespace io_budget
+	{
+		constexpr const char* DESCRIPTION = "Megabytes of input that running batch jobs may have open at once; a job waits until its inputs fit.";
+		constexpr std::size_t DEFAULT = 1024;
+	} // namespace io_budget
+
 	namespace operation
 	{
 		constexpr const char* REINTERPRET   = "reint";
@@ -158,6 +245,8 @@ namespace opt
 		constexpr const char* STUTTER       = "stutr";
 		constexpr const char* ENCODE_MP3    = "enmp3";
 		constexpr const char* DECODE_MP3    = "demp3";
+		constexpr const char* PIPE          = "pipe";
+		constexpr const char* BATCH         = "batch"; // runs a manifest of the operations above, not one itself
 
 		enum OPERATIONS
 		{
@@ -171,11 +260,17 @@ namespace opt
 			OP_DROPOUT,
 			OP_STUTTER,
 			OP_ENCODE_MP3,
-			OP_DECODE_MP3
+			OP_DECODE_MP3,
+			OP_PIPE
 		};
+
+		// a pipe stage is "op" or "op:key=value:key" with keys being the short options without
+		// the dash (s=512, p=0.01, x=256-1024, a, ...); stages are separated by commas
+		constexpr char PIPE_STAGE_SEPARATOR = ',';
+		constexpr char PIPE_PARAM_SEPARATOR = ':';
 	}
 
-	std::string TagFile(const std::string& filename, const std::string& operation, wf::WaveFile::Channels channels, wf::WaveFile::SampleRate sampleRate, wf::WaveFile::BitsPerSample bitDepth, wf::WaveFile::AudioFormat format)
+	inline std::string TagFile(const std::string& filename, const std::string& operation, wf::WaveFile::Channels channels, wf::WaveFile::SampleRate sampleRate, wf::WaveFile::BitsPerSample bitDepth, wf::WaveFile::AudioFormat format)
 	{
 		std::string taggedName = filename;
 
@@ -197,7 +292,7 @@ namespace opt
 		return taggedName;
 	}
 
-	void DisplayHelp()
+	inline void DisplayHelp()
 	{
 		std::cout << "WaveTransformer Help:\n";
 		std::cout << "Format: <operation> [inputs...] <options> [value]...\n";
@@ -213,6 +308,11 @@ namespace opt
 		std::cout << "  " << operation::STUTTER << ": Set every nth byte to zero.\n";
 		std::cout << "  " << operation::ENCODE_MP3 << ": Encode the input wave file to MP3 format.\n";
 		std::cout << "  " << operation::DECODE_MP3 << ": Decode the input MP3 file to wave format.\n";
+		std::cout << "  " << operation::PIPE << ": Run several operations on the input in memory, e.g. " << operation::PIPE << " \"shuff:s=512,bitfl:p=0.01,stutr:n=7\" in.bin\n";
+		std::cout << "    Stages take the short options without the dash as key=value (x=min-max, a for byte align, d for samples); options given\n";
+		std::cout << "    after the inputs apply to every stage. Stages: shuff, bymir, bitfl, caswp, rngsh, dropt, stutr.\n";
+		std::cout << "  " << operation::BATCH << ": Run the jobs of a manifest file concurrently. One job per line, written like a command line\n";
+		std::cout << "    without the program name (operation, inputs, options, output); blank lines and lines starting with # are skipped.\n";
 		std::cout << "Options:\n";
 		std::cout << HELP_SHORT << ", " << HELP_LONG << ": " << HELP_DESCRIPTION << "\n";
 		std::cout << CHANNELS_SHORT << ", " << CHANNELS_LONG << ": " << channels::DESCRIPTION << " (Default: " << (channels::DEFAULT == 1 ? "mono" : "stereo") << ")\n";
@@ -226,7 +326,18 @@ namespace opt
 		std::cout << BLOCK_RANGE_SHORT << ", " << BLOCK_RANGE_LONG << ": " << block_range::DESCRIPTION << " (Default: " << block_range::DEFAULT_MIN << ' - ' << block_range::DEFAULT_MAX << ")\n";
 		std::cout << BLOCK_BYTE_ALIGN_SHORT << ", " << BLOCK_BYTE_ALIGN_LONG << ": " << byte_align::DESCRIPTION << " (Default: " << (byte_align::DEFAULT ? "true" : "false") << ")\n";
 		std::cout << NTH_BYTE_SHORT << ", " << NTH_BYTE_LONG << ": " << nth_byte::DESCRIPTION << " (Default: " << nth_byte::DEFAULT << ")\n";
+		std::cout << SAMPLE_DOMAIN_SHORT << ", " << SAMPLE_DOMAIN_LONG << ": " << sample_domain::DESCRIPTION << " (Default: " << (sample_domain::DEFAULT ? "true" : "false") << ")\n";
+		std::cout << UNIT_SHORT << ", " << UNIT_LONG << ": " << unit::DESCRIPTION << " (Default: " << unit::DEFAULT << ")\n";
+		std::cout << SEED_SHORT << ", " << SEED_LONG << ": " << seed::DESCRIPTION << " (Default: random)\n";
+		std::cout << OFFSET_SHORT << ", " << OFFSET_LONG << ": " << offset::DESCRIPTION << " (Default: " << offset::DEFAULT << ")\n";
+		std::cout << LENGTH_SHORT << ", " << LENGTH_LONG << ": " << length::DESCRIPTION << " (Default: rest of the file)\n";
+		std::cout << WAV_INPUT_SHORT << ", " << WAV_INPUT_LONG << ": " << wav_input::DESCRIPTION << " (Default: " << (wav_input::DEFAULT ? "true" : "false") << ")\n";
 		std::cout << CONVERT_MP3_SHORT << ", " << CONVERT_MP3_LONG << ": " << convert_mp3::DESCRIPTION << " (Default: " << (convert_mp3::DEFAULT ? "true" : "false") << ")\n";
+		std::cout << PARALLEL_MP3_SHORT << ", " << PARALLEL_MP3_LONG << ": " << parallel_mp3::DESCRIPTION << " (Default: " << (parallel_mp3::DEFAULT ? "true" : "false") << ")\n";
 		std::cout << VERBOSE_MPG123_SHORT << ", " << VERBOSE_MPG123_LONG << ": " << verbose_mpg123::DESCRIPTION << " (Default: " << (verbose_mpg123::DEFAULT ? "true" : "false") << ")\n";
+		std::cout << STATS_SHORT << ", " << STATS_LONG << " [file.json]: " << stats::DESCRIPTION << " (Default: " << (stats::DEFAULT ? "true" : "false") << ")\n";
+		std::cout << JOBS_SHORT << ", " << JOBS_LONG << ": " << jobs::DESCRIPTION << " (Default: " << jobs::DEFAULT << ")\n";
+		std::cout << THREADS_SHORT << ", " << THREADS_LONG << ": " << threads::DESCRIPTION << " (Default: " << threads::DEFAULT << ")\n";
+		std::cout << IO_BUDGET_SHORT << ", " << IO_BUDGET_LONG << ": " << io_budget::DESCRIPTION << " (Default: " << io_budget::DEFAULT << ")\n";
 	}
 }
\ No newline at end of file
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include <exception>
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <optional>
+#include <functional>
+#include <memory>
+#include <atomic>
+
+namespace par
+{
+	// Threads that parallel work runs on, the calling thread included: one per core unless
+	// SetThreadCount was called before the first parallel call (the pool is sized once).
+	std::size_t ThreadCount();
+	// 0 for one per core
+	void SetThreadCount(std::size_t threads);
+
+	// Work-stealing pool behind ParallelFor. Every worker has its own deque of tasks: it takes
+	// them from the front and, once that is empty, steals from the back of another worker's.
+	// A thread waiting for a Run to finish runs queued tasks itself instead of blocking, so
+	// nested Runs (a fused pass whose kernels split their tiles again) cannot starve the pool.
+	class ThreadPool
+	{
+	public:
+		// threads - 1 workers, the thread calling Run is the last one
+		explicit ThreadPool(std::size_t threads);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		std::size_t Size() const { return queues.size(); }
+
+		// Call task(i) for every i in [0, count) and return once all calls are done. The first
+		// exception thrown by a task is rethrown after that.
+		void Run(std::size_t count, const std::function<void(std::size_t)>& task);
+
+	private:
+		struct Batch;
+		struct Task
+		{
+			Batch* batch;
+			std::size_t index;
+		};
+		struct Queue
+		{
+			std::mutex mutex;
+			std::deque<Task> tasks;
+		};
+
+		void Work(std::size_t worker);
+		bool TryRunOne(std::size_t home);
+		void Execute(const Task& task);
+
+		std::vector<std::unique_ptr<Queue>> queues; // one per worker, the last one for outside callers
+		std::vector<std::thread> workers;
+		std::atomic<std::size_t> queued{ 0 };
+		std::atomic<std::size_t> nextQueue{ 0 };
+		std::mutex sleepMutex;
+		std::condition_variable wake;
+		bool stopping = false;
+	};
+
+	// the process-wide pool, created with ThreadCount() threads on first use
+	ThreadPool& Pool();
+
+	// ranges ParallelFor makes per thread, so threads that finish early can take over the rest
+	constexpr std::size_t CHUNKS_PER_THREAD = 4;
+
+	// Split [0, count) into contiguous ranges of at least minPerThread and call fn(begin, end) on
+	// each, on the pool. Small inputs run on the calling thread. The first exception thrown by a
+	// range is rethrown once all of them have finished.
+	template<typename Fn>
+	void ParallelFor(std::size_t count, Fn&& fn, std::size_t minPerThread = 1)
+	{
+		if (count == 0) return;
+
+		std::size_t threads = ThreadCount();
+		std::size_t chunks = std::min(threads * CHUNKS_PER_THREAD, std::max<std::size_t>(1, count / std::max<std::size_t>(1, minPerThread)));
+		if (threads <= 1 || chunks <= 1)
+		{
+			fn(std::size_t{ 0 }, count);
+			return;
+		}
+
+		Pool().Run(chunks, [&](std::size_t chunk)
+		{
+			fn(count * chunk / chunks, count * (chunk + 1) / chunks);
+		});
+	}
+
+	// Blocking FIFO between pipeline stages. Push waits while capacity items are queued, so a
+	// fast producer cannot run ahead of its consumer. Close ends the stream: Pop drains what is
+	// left and then returns nothing, and Push returns false so a producer can stop early.
+	template<typename T>
+	class BoundedQueue
+	{
+	public:
+		explicit BoundedQueue(std::size_t capacity) : capacity(std::max<std::size_t>(1, capacity)) {}
+
+		bool Push(T item)
+		{
+			std::unique_lock<std::mutex> lock{ mutex };
+			notFull.wait(lock, [this]() { return closed || items.size() < capacity; });
+			if (closed) return false;
+
+			items.push_back(std::move(item));
+			notEmpty.notify_one();
+			return true;
+		}
+
+		std::optional<T> Pop()
+		{
+			std::unique_lock<std::mutex> lock{ mutex };
+			notEmpty.wait(lock, [this]() { return closed || !items.empty(); });
+			if (items.empty()) return std::nullopt;
+
+			T item = std::move(items.front());
+			items.pop_front();
+			notFull.notify_one();
+			return item;
+		}
+
+		void Close()
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			closed = true;
+			notFull.notify_all();
+			notEmpty.notify_all();
+		}
+
+	private:
+		std::size_t capacity;
+		std::deque<T> items;
+		bool closed = false;
+		std::mutex mutex;
+		std::condition_variable notFull;
+		std::condition_variable notEmpty;
+	};
+
+	// Counted budget shared between threads, e.g. megabytes of input in flight. Acquire waits
+	// until amount units are free and takes them all at once, so two callers can never each
+	// hold part of what they need and wait on each other. Requests larger than the whole
+	// budget are capped to it and simply run alone.
+	class Budget
+	{
+	public:
+		explicit Budget(std::size_t total) : total(std::max<std::size_t>(1, total)), available(this->total) {}
+
+		std::size_t Acquire(std::size_t amount)
+		{
+			amount = std::min(amount, total);
+			std::unique_lock<std::mutex> lock{ mutex };
+			released.wait(lock, [this, amount]() { return available >= amount; });
+			available -= amount;
+			return amount;
+		}
+
+		// amount as returned by Acquire
+		void Release(std::size_t amount)
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			available += amount;
+			released.notify_all();
+		}
+
+	private:
+		std::size_t total;
+		std::size_t available;
+		std::mutex mutex;
+		std::condition_variable released;
+	};
+}
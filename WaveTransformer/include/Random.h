@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <array>
+
+namespace rng
+{
+	// Philox4x32-10 counter-based generator (Salmon et al., "Parallel Random Numbers: As Easy
+	// as 1, 2, 3"). Every (key, counter) pair maps to four independent 32-bit values, so any
+	// part of a random sequence can be produced on any thread without sharing state.
+	class Philox4x32
+	{
+	public:
+		using Counter = std::array<std::uint32_t, 4>;
+		using Key = std::array<std::uint32_t, 2>;
+
+		static Counter Generate(Counter counter, Key key)
+		{
+			for (int round = 0; round < 10; ++round)
+			{
+				if (round > 0)
+				{
+					key[0] += W0;
+					key[1] += W1;
+				}
+
+				std::uint64_t product0 = static_cast<std::uint64_t>(M0) * counter[0];
+				std::uint64_t product1 = static_cast<std::uint64_t>(M1) * counter[2];
+				counter = {
+					static_cast<std::uint32_t>(product1 >> 32) ^ counter[1] ^ key[0],
+					static_cast<std::uint32_t>(product1),
+					static_cast<std::uint32_t>(product0 >> 32) ^ counter[3] ^ key[1],
+					static_cast<std::uint32_t>(product0)
+				};
+			}
+			return counter;
+		}
+
+	private:
+		static constexpr std::uint32_t M0 = 0xD2511F53;
+		static constexpr std::uint32_t M1 = 0xCD9E8D57;
+		static constexpr std::uint32_t W0 = 0x9E3779B9;
+		static constexpr std::uint32_t W1 = 0xBB67AE85;
+	};
+
+	// Sequential draws from one independent Philox stream, picked by (seed, stream).
+	// Streams with the same seed and id always produce the same values.
+	class PhiloxStream
+	{
+	public:
+		PhiloxStream(std::uint64_t seed, std::uint64_t stream)
+			: key{ static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32) },
+			counter{ 0, 0, static_cast<std::uint32_t>(stream), static_cast<std::uint32_t>(stream >> 32) }
+		{}
+
+		std::uint32_t Next()
+		{
+			if (used == values.size())
+			{
+				values = Philox4x32::Generate(counter, key);
+				if (++counter[0] == 0) ++counter[1];
+				used = 0;
+			}
+			return values[used++];
+		}
+
+		// uniform in the open interval (0, 1)
+		double NextUnit()
+		{
+			return (static_cast<double>(Next()) + 0.5) * (1.0 / 4294967296.0);
+		}
+
+	private:
+		Philox4x32::Key key;
+		Philox4x32::Counter counter;
+		Philox4x32::Counter values{};
+		std::size_t used = 4;
+	};
+}
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <type_traits>
+#include <algorithm>
+#include <stdexcept>
+#include <iostream>
+#include <cmath>
+#include <limits>
+
+#include "Kernel.h"
+#include "WaveFile.h"
+#include "Simd.h"
+
+namespace algo
+{
+	// Sample-domain variants of the block kernels: they move, zero and flip whole samples instead
+	// of bytes, so 16/24/32-bit samples are never split. A frame is one sample of every channel.
+	// Every kernel is instantiated per bit depth and channel count, which makes frame and sample
+	// sizes compile-time constants; the format is looked at once, when the kernel is made.
+	namespace sample
+	{
+		using BitsPerSample = wf::WaveFile::BitsPerSample;
+		using Channels = wf::WaveFile::Channels;
+
+		template<BitsPerSample B>
+		constexpr std::size_t SampleBytes = static_cast<std::size_t>(B) / 8;
+
+		template<BitsPerSample B, Channels C>
+		constexpr std::size_t FrameBytes = SampleBytes<B> * static_cast<std::size_t>(C);
+
+		// 8 bit pcm is unsigned, its silence is the midpoint
+		template<BitsPerSample B>
+		constexpr std::uint8_t Silence = B == BitsPerSample::BPS_8bit ? 0x80 : 0x00;
+
+		// reverse the order of frames within each block of blockFrames frames
+		template<BitsPerSample B, Channels C>
+		void MirrorFrames(std::span<std::uint8_t> window, std::size_t blockFrames)
+		{
+			simd::MirrorFrames(window.data(), window.size(), FrameBytes<B, C>, blockFrames);
+		}
+
+		// move the last frame of each block of blockFrames frames to its front
+		template<BitsPerSample B, Channels C>
+		void RotateFrames(std::span<std::uint8_t> window, std::size_t blockFrames)
+		{
+			simd::RotateFramesRight(window.data(), window.size(), FrameBytes<B, C>, blockFrames);
+		}
+
+		// silence every nth frame of the stream, window starts at byte offset of it
+		template<BitsPerSample B, Channels C>
+		void SilenceFrames(std::span<std::uint8_t> window, std::uint64_t offset, std::size_t n)
+		{
+			constexpr std::size_t F = FrameBytes<B, C>;
+			std::uint64_t firstFrame = offset / F;
+
+			// first frame in the window with (firstFrame + i) % n == n - 1
+			std::size_t first = static_cast<std::size_t>((n - 1 - firstFrame % n) % n);
+			simd::SilenceFrames(window.data(), window.size(), F, n, first, Silence<B>);
+		}
+
+		// samples per independent random stream in FlipSampleBits, fixed so the output only depends on the seed
+		constexpr std::size_t BIT_FLIP_SEGMENT_SAMPLES = 16 * 1024;
+
+		// flip one random bit of each sample with the given probability, drawn the same way as
+		// kernel::ByteBitFlip: geometric gaps between flipped samples, one Philox stream per segment
+		template<BitsPerSample B>
+		void FlipSampleBits(std::span<std::uint8_t> window, std::uint64_t offset, double flipProbability, std::uint64_t seed)
+		{
+			constexpr std::size_t S = SampleBytes<B>;
+			constexpr std::size_t SEGMENT = BIT_FLIP_SEGMENT_SAMPLES * S;
+
+			if (flipProbability <= 0.0) return;
+
+			double logKeep = flipProbability < 1.0 ? std::log1p(-flipProbability) : -std::numeric_limits<double>::infinity();
+			std::size_t segments = (window.size() + SEGMENT - 1) / SEGMENT;
+
+			par::ParallelFor(segments, [&](std::size_t begin, std::size_t end)
+			{
+				for (std::size_t segment = begin; segment < end; ++segment)
+				{
+					std::size_t start = segment * SEGMENT;
+					std::size_t samples = std::min(SEGMENT, window.size() - start) / S;
+					std::uint8_t* bytes = window.data() + start;
+
+					rng::PhiloxStream stream{ seed, offset / SEGMENT + segment };
+
+					auto gap = [&]()
+					{
+						double skip = std::floor(std::log(stream.NextUnit()) / logKeep);
+						return skip < static_cast<double>(samples) ? static_cast<std::size_t>(skip) : samples;
+					};
+
+					for (std::size_t i = gap(); i < samples; i += 1 + gap())
+					{
+						// bit in [0, 8 * S) without a division, samples are little endian
+						std::size_t bit = static_cast<std::size_t>((static_cast<std::uint64_t>(stream.Next()) * (8 * S)) >> 32);
+						bytes[i * S + bit / 8] ^= static_cast<std::uint8_t>(1 << (bit & 7));
+					}
+				}
+			}, 16);
+		}
+
+		// Calls make.template operator()<B, C>() for the bit depth and channel count given at runtime.
+		template<typename Make>
+		kernel::BlockKernel Dispatch(BitsPerSample bps, Channels channels, const char* algoName, Make&& make)
+		{
+			auto withChannels = [&]<BitsPerSample B>() -> kernel::BlockKernel
+			{
+				switch (channels)
+				{
+				case Channels::Mono:
+					return make.template operator()<B, Channels::Mono>();
+				case Channels::Stereo:
+					return make.template operator()<B, Channels::Stereo>();
+				}
+				std::cerr << "(algo::" << algoName << ") Error: unsupported channel count " << static_cast<int>(channels) << std::endl;
+				throw std::runtime_error(std::string("(algo::") + algoName + ") Unsupported channel count");
+			};
+
+			switch (bps)
+			{
+			case BitsPerSample::BPS_8bit:
+				return withChannels.template operator()<BitsPerSample::BPS_8bit>();
+			case BitsPerSample::BPS_16bit:
+				return withChannels.template operator()<BitsPerSample::BPS_16bit>();
+			case BitsPerSample::BPS_24bit:
+				return withChannels.template operator()<BitsPerSample::BPS_24bit>();
+			case BitsPerSample::BPS_32bit:
+				return withChannels.template operator()<BitsPerSample::BPS_32bit>();
+			}
+			std::cerr << "(algo::" << algoName << ") Error: unsupported bit depth " << static_cast<int>(bps) << std::endl;
+			throw std::runtime_error(std::string("(algo::") + algoName + ") Unsupported bit depth");
+		}
+
+		inline void CheckPositive(std::size_t value, const char* algoName, const char* what)
+		{
+			if (value == 0)
+			{
+				std::cerr << "(algo::" << algoName << ") Error: " << what << " must be greater than 0" << std::endl;
+				throw std::runtime_error(std::string("(algo::") + algoName + ") Invalid " + what + " value");
+			}
+		}
+
+		// reverse the order of samples (whole frames) within each block of blockFrames frames
+		inline kernel::BlockKernel Mirror(std::size_t blockFrames, BitsPerSample bps, Channels channels)
+		{
+			CheckPositive(blockFrames, "SampleMirror", "blockSize");
+			return Dispatch(bps, channels, "SampleMirror", [blockFrames]<BitsPerSample B, Channels C>() -> kernel::BlockKernel
+			{
+				return kernel::Blocks("SampleMirror", blockFrames * FrameBytes<B, C>, 1, [blockFrames](std::span<std::uint8_t> blocks, std::size_t, std::uint64_t)
+				{
+					MirrorFrames<B, C>(blocks, blockFrames);
+				});
+			});
+		}
+
+		// shift each block of blockFrames frames right by one frame
+		inline kernel::BlockKernel CascadeSwap(std::size_t blockFrames, BitsPerSample bps, Channels channels)
+		{
+			CheckPositive(blockFrames, "SampleCascadeSwap", "blockSize");
+			return Dispatch(bps, channels, "SampleCascadeSwap", [blockFrames]<BitsPerSample B, Channels C>() -> kernel::BlockKernel
+			{
+				return kernel::Blocks("SampleCascadeSwap", blockFrames * FrameBytes<B, C>, 1, [blockFrames](std::span<std::uint8_t> blocks, std::size_t, std::uint64_t)
+				{
+					RotateFrames<B, C>(blocks, blockFrames);
+				});
+			});
+		}
+
+		// silence every nth frame
+		inline kernel::BlockKernel Stutter(std::size_t n, BitsPerSample bps, Channels channels)
+		{
+			CheckPositive(n, "SampleStutter", "n");
+			return Dispatch(bps, channels, "SampleStutter", [n]<BitsPerSample B, Channels C>() -> kernel::BlockKernel
+			{
+				// one frame blocks, so first is the frame the run starts at
+				return kernel::Blocks("SampleStutter", FrameBytes<B, C>, 1, [n](std::span<std::uint8_t> frames, std::size_t, std::uint64_t first)
+				{
+					SilenceFrames<B, C>(frames, first * FrameBytes<B, C>, n);
+				});
+			});
+		}
+
+		// flip one random bit within each sample with the given probability
+		inline kernel::BlockKernel BitFlip(double flipProbability, std::uint64_t seed, BitsPerSample bps, Channels channels)
+		{
+			return Dispatch(bps, channels, "SampleBitFlip", [flipProbability, seed]<BitsPerSample B, Channels C>() -> kernel::BlockKernel
+			{
+				// a segment holds whole frames of either channel count
+				return { BIT_FLIP_SEGMENT_SAMPLES * SampleBytes<B>, [flipProbability, seed](std::span<std::uint8_t> window, std::uint64_t offset)
+				{
+					FlipSampleBits<B>(window, offset, flipProbability, seed);
+				} };
+			});
+		}
+	}
+}
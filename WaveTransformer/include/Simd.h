@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SIMD_X86 1
+#else
+#define SIMD_X86 0
+#endif
+
+// enables an instruction set for a single function, so the rest of the build keeps the
+// baseline target and the function is only called after a runtime check
+#if SIMD_X86 && (defined(__GNUC__) || defined(__clang__))
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SIMD_TARGET(isa)
+#endif
+
+namespace simd
+{
+	// runtime cpu feature checks, false on non-x86 targets
+	bool HasSSSE3();
+	bool HasAVX2();
+
+	// Copy the bytes of in whose bit is set in mask (bit i % 8 of mask[i / 8]) to out, in order.
+	// Returns the number of bytes written; out must have room for all of them.
+	std::size_t CompactBytes(const std::uint8_t* in, const std::uint8_t* mask, std::size_t size, std::uint8_t* out);
+
+	// Interleave count inputs unit bytes at a time: out = in0[u0] in1[u0] ... in0[u1] in1[u1] ...
+	// Every input must hold units * unit bytes, out receives count times that.
+	// 2, 4 and 8 inputs with units of up to 16 / count bytes use an SSE2 transpose.
+	void Interleave(const std::uint8_t* const* inputs, std::size_t count, std::size_t unit, std::size_t units, std::uint8_t* out);
+
+	// Float to little-endian pcm (8 bit unsigned, 16/24/32 bit signed, 24 bit packed) with the
+	// same scaling, clamping and truncation as WaveFile::FloatToPCM, bit for bit. The kernel is
+	// picked once per call (AVX2, SSE2). Only whole vectors are converted: the return value is
+	// the number of samples (per channel) done and the caller converts the rest.
+	std::size_t FloatToPCM(const float* in, std::size_t count, int bits, std::uint8_t* out);
+	std::size_t FloatToPCMStereo(const float* left, const float* right, std::size_t count, int bits, std::uint8_t* out);
+
+	// In place, for every block of blockSize bytes (the last one may be shorter): reverse its
+	// bytes, or move its last byte to the front. Blocks of up to 16 bytes are done several per
+	// PSHUFB (32 bytes per step with AVX2 when they tile 16 bytes), longer mirrored blocks are
+	// reversed a vector at a time from both ends. Only bytes in [data, data + size) are written.
+	void MirrorBlocks(std::uint8_t* data, std::size_t size, std::size_t blockSize);
+	void RotateBlocksRight(std::uint8_t* data, std::size_t size, std::size_t blockSize);
+
+	// The same on frames of frameBytes bytes (one sample of every channel), blocks being
+	// blockFrames frames: the frames of a block are reversed, or its last frame moves to the
+	// front, and the bytes within a frame keep their order. The controls above are built per frame
+	// size, so blocks of up to 16 bytes still go several per PSHUFB; longer mirrored blocks swap
+	// vectors of whole frames (15 bytes of 3 byte frames, 12 of 6 byte ones) from both ends.
+	// A trailing partial frame stays where it is.
+	void MirrorFrames(std::uint8_t* data, std::size_t size, std::size_t frameBytes, std::size_t blockFrames);
+	void RotateFramesRight(std::uint8_t* data, std::size_t size, std::size_t frameBytes, std::size_t blockFrames);
+
+	// Set frame first and every nth frame after it to silence (every byte of it), a trailing partial
+	// frame excluded. Patterns repeating within less than 12 bytes are blended in a vector at a
+	// time from a table of which bytes to keep; sparser ones are written frame by frame.
+	void SilenceFrames(std::uint8_t* data, std::size_t size, std::size_t frameBytes, std::size_t n, std::size_t first, std::uint8_t silence);
+
+	// left/right float samples to interleaved stereo, same return convention as above
+	std::size_t InterleaveFloatStereo(const float* left, const float* right, std::size_t count, std::uint8_t* out);
+}
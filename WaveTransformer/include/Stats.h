@@ -0,0 +1,114 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace stats
+{
+	// One named stage of a run. Scopes with the same name at the same depth are merged into one
+	// entry (a stage timed window by window): times and bytes add up and count says how many.
+	struct Stage
+	{
+		std::string name;
+		int depth = 0;
+		std::uint64_t count = 0;
+		double wallSeconds = 0.0;
+		double cpuSeconds = 0.0; // of the whole process, so stages running at the same time overlap
+		std::uint64_t bytesIn = 0;
+		std::uint64_t bytesOut = 0;
+		std::uint64_t peakRss = 0; // process high-water mark in bytes when the stage last ended
+	};
+
+	// Collects the stages of one run, from any number of threads.
+	class Recorder
+	{
+	public:
+		// index of the stage, created when first seen so stages are listed in the order they start
+		std::size_t Enter(const char* name, int depth);
+		void Add(std::size_t stage, double wallSeconds, double cpuSeconds, std::uint64_t bytesIn, std::uint64_t bytesOut, std::uint64_t peakRss);
+		std::vector<Stage> Stages() const;
+
+		void PrintTable(std::ostream& out) const;
+		void WriteJson(std::ostream& out) const;
+
+	private:
+		mutable std::mutex mutex;
+		std::vector<Stage> stages;
+	};
+
+	// process cpu time (user + system) in seconds and peak resident set size in bytes, 0 where unsupported
+	double ProcessCpuSeconds();
+	std::uint64_t PeakRss();
+
+	namespace detail
+	{
+		extern thread_local Recorder* current;
+		extern thread_local int depth;
+	}
+
+	// the recorder of the calling thread, nullptr when stats are off
+	inline Recorder* Current() { return detail::current; }
+	inline int Depth() { return detail::depth; }
+
+	// Makes recorder the one scopes on this thread report to while the session lives. Threads
+	// started inside a stage pass the parent's Current() and Depth() to report beneath it.
+	class Session
+	{
+	public:
+		explicit Session(Recorder* recorder, int depth = 0)
+			: previous(detail::current), previousDepth(detail::depth)
+		{
+			detail::current = recorder;
+			detail::depth = depth;
+		}
+		~Session()
+		{
+			detail::current = previous;
+			detail::depth = previousDepth;
+		}
+
+		Session(const Session&) = delete;
+		Session& operator=(const Session&) = delete;
+
+	private:
+		Recorder* previous;
+		int previousDepth;
+	};
+
+	// Times the enclosing block as a stage of the current recorder. With stats off this is one
+	// thread_local read on entry and a branch on exit, so scopes can stay in every path.
+	class Scope
+	{
+	public:
+		explicit Scope(const char* name) : recorder(detail::current)
+		{
+			if (recorder) Start(name);
+		}
+		~Scope()
+		{
+			if (recorder) Stop();
+		}
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+		void BytesIn(std::uint64_t bytes) { bytesIn += bytes; }
+		void BytesOut(std::uint64_t bytes) { bytesOut += bytes; }
+
+	private:
+		void Start(const char* name);
+		void Stop();
+
+		Recorder* recorder;
+		std::size_t stage = 0;
+		int depth = 0;
+		std::chrono::steady_clock::time_point start;
+		double cpuStart = 0.0;
+		std::uint64_t bytesIn = 0;
+		std::uint64_t bytesOut = 0;
+	};
+}
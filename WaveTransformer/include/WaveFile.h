@@ -5,7 +5,11 @@
 #include <vector>
 #include <stdexcept>
 #include <limits>
+#include <cstring>
 #include <fstream>
+#include <span>
+
+#include "MappedFile.h"
 
 namespace wf 
 {
@@ -72,6 +76,27 @@ namespace wf
 			std::uint32_t chunkSize;                    
 		};
 
+#pragma pack(push, 1)
+		// RF64 (EBU Tech 3306) 64-bit sizes, placed directly after the riff header.
+		// Written as a "JUNK" chunk of the same size when the final size is not known yet.
+		struct ds64Chunk
+		{
+			std::uint8_t chunkID[4] = { 'd','s','6','4' };      // "ds64"
+			std::uint32_t chunkSize = 28;
+			std::uint64_t riffSize = 0;                  // (file size) - 8
+			std::uint64_t dataSize = 0;
+			std::uint64_t sampleCount = 0;               // number of sample frames
+			std::uint32_t tableLength = 0;               // no extra chunk sizes
+		};
+#pragma pack(pop)
+
+		enum class HeaderLayout
+		{
+			RIFF,     // plain 44 byte header
+			Reserved, // RIFF with a JUNK chunk that can become ds64
+			RF64
+		};
+
 	public:
 		WaveFile(const std::string& path, 
 			SampleRate sampleRate = SampleRate::SR_44100Hz,
@@ -83,10 +108,43 @@ namespace wf
 		std::string GetPath() const;
 		const std::vector<std::uint8_t>& GetData() const;
 
-		// void ReadIn();
+		// Where the samples of a wave file are and how they are laid out.
+		struct Contents
+		{
+			SampleRate sampleRate = SampleRate::SR_44100Hz;
+			BitsPerSample bps = BitsPerSample::BPS_16bit;
+			Channels channels = Channels::Mono;
+			AudioFormat format = AudioFormat::PCM;
+			std::uint64_t dataOffset = 0; // of the data chunk payload, from the start of the file
+			std::uint64_t dataSize = 0;
+		};
+
+		// Walk the chunks of a RIFF or RF64 wave file held in memory, skipping the ones it does not
+		// know. Throws when file is not a wave file or lacks a fmt or data chunk.
+		static Contents Parse(std::span<const std::uint8_t> file);
+
+		// Take over the format of the wave file at path and return where its samples are. The file is
+		// only mapped while its header is parsed, see Parse.
+		Contents ReadIn();
+
 		void WriteOut() const;
 		void WriteRaw() const;
 
+		// streaming output: writes a placeholder header, appends pcm chunks as they
+		// are produced, then patches the chunk sizes once the total is known.
+		// Payloads over the 32-bit RIFF limit are written as RF64.
+		static constexpr std::uint64_t UnknownSize = std::numeric_limits<std::uint64_t>::max();
+		// largest payload whose RIFF chunk size still fits in 32 bits
+		static constexpr std::uint64_t MaxRiffDataSize = std::numeric_limits<std::uint32_t>::max() - (sizeof(riffHeader) + sizeof(fmtChunk) + sizeof(dataChunkHeader) - 8);
+		// the same with the JUNK chunk a stream of unknown size keeps for ds64
+		static constexpr std::uint64_t MaxReservedDataSize = MaxRiffDataSize - sizeof(ds64Chunk);
+		void Open(std::uint64_t expectedSize = UnknownSize);
+		void Append(std::span<const std::uint8_t> pcm);
+		// append length bytes of input from offset on without reading them into memory
+		void Append(const io::InputFile& input, std::uint64_t offset, std::uint64_t length);
+		void Finalize();
+		bool IsStreaming() const;
+
 		void SetData(const std::vector<std::uint8_t>& pcm); // raw pcm data (interlaced if stereo)
 		void SetData(std::vector<std::uint8_t>&& pcm); // raw pcm data (interlaced if stereo)
 
@@ -99,6 +157,8 @@ namespace wf
 		template<typename T>
 		T FloatToPCM(float sample, BitsPerSample bps) const;
 
+		void WriteHeader(std::ostream& file, std::uint64_t dataSize, HeaderLayout layout) const;
+
 	private:
 		std::string path;
 		SampleRate sampleRate;
@@ -106,6 +166,11 @@ namespace wf
 		Channels channels;
 		AudioFormat format;
 		std::vector<std::uint8_t> data; // raw pcm data
+
+		std::ofstream stream; // open while streaming
+
+		std::uint64_t streamedBytes = 0;
+		HeaderLayout streamLayout = HeaderLayout::RIFF;
 	};
 	template<typename T>
 	inline T WaveFile::FloatToPCM(float sample, BitsPerSample bps) const